@@ -150,6 +150,9 @@ int main(int argc,char *argv[])
 	bool debug = false;
 	bool verbose = false;
 	HilbertStateType gs(engine,ne,debug);
+	// the up and down factors repeat across sigma and sigma2
+	HilbertStateType::ClosedProductCacheType cache;
+	gs.cache(&cache);
 	
 	size_t sigma3 = 0;
 	
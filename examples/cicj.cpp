@@ -4,6 +4,7 @@
 // <c^\dagger_i c_j >
 #include <cstdlib>
 #include <unistd.h>
+#include <pthread.h>
 #include "Engine.h"
 #include "GeometryLibrary.h"
 #include "ConcurrencySerial.h"
@@ -22,14 +23,53 @@ typedef FreeFermions::GeometryParameters<RealType> GeometryParamsType;
 typedef FreeFermions::GeometryLibrary<MatrixType,GeometryParamsType> GeometryLibraryType;
 typedef FreeFermions::Engine<RealType,FieldType,ConcurrencyType> EngineType;
 typedef FreeFermions::CreationOrDestructionOp<EngineType> OperatorType;
-typedef FreeFermions::HilbertState<OperatorType> HilbertStateType;
+// every closed product here is a c^\dagger c, fixed at compile time
+typedef FreeFermions::OperatorStrings<OperatorType>::HoppingType HoppingType;
+typedef FreeFermions::DummyOperator<FieldType> DummyOperatorType;
+typedef FreeFermions::HilbertState<OperatorType,
+                                   DummyOperatorType,
+                                   HoppingType> HilbertStateType;
 
 typedef OperatorType::FactoryType OpNormalFactoryType;
 
 void usage(const std::string& thisFile)
 {
 	std::cout<<thisFile<<": USAGE IS "<<thisFile<<" ";
-	std::cout<<" -n sites -e electronsUp -g geometry,[leg,filename]\n";
+	std::cout<<" -n sites -e electronsUp -g geometry,[leg,filename]";
+	std::cout<<" [-t threads]\n";
+}
+
+// the rows first, first+stride, ... of one orbital, in one thread:
+// the engine and gs are shared, the factory is the thread's own
+struct RowsType {
+	const EngineType* engine;
+	const HilbertStateType* gs;
+	size_t n;
+	size_t orbital;
+	size_t first;
+	size_t stride;
+	std::vector<std::vector<FieldType> >* rows;
+};
+
+void* computeRows(void* arg)
+{
+	const RowsType& r = *static_cast<RowsType*>(arg);
+	OpNormalFactoryType opNormalFactory(*r.engine);
+	size_t sigma = 0;
+	size_t offset = r.orbital*r.n;
+	for (size_t site = r.first; site<r.n; site += r.stride) {
+		OperatorType& myOp = opNormalFactory(OperatorType::DESTRUCTION,site+offset,sigma);
+		std::vector<FieldType>& row = (*r.rows)[site];
+		row.resize(r.n);
+		for (size_t site2=0; site2<r.n; site2++) {
+			HilbertStateType phi = *r.gs;
+			myOp.applyTo(phi);
+			OperatorType& myOp2 = opNormalFactory(OperatorType::CREATION,site2+offset,sigma);
+			myOp2.applyTo(phi);
+			row[site2] = scalarProduct(*r.gs,phi);
+		}
+	}
+	return 0;
 }
 	
 void readPotential(std::vector<RealType>& v,const std::string& filename)
@@ -105,10 +145,11 @@ int main(int argc,char* argv[])
 	GeometryParamsType geometryParams;
 	std::vector<std::string> str;
 	int opt = 0;
+	size_t threads = 1;
 	
 	geometryParams.type = GeometryLibraryType::CHAIN;
 	
-	while ((opt = getopt(argc, argv, "n:e:g:p:")) != -1) {
+	while ((opt = getopt(argc, argv, "n:e:g:p:t:")) != -1) {
 		switch (opt) {
 			case 'n':
 				n = atoi(optarg);
@@ -125,6 +166,9 @@ int main(int argc,char* argv[])
 			case 'p':
 				readPotential(v,optarg);
 				break;
+			case 't':
+				threads = atoi(optarg);
+				break;
 			default: /* '?' */
 				usage("setMyGeometry");
 				throw std::runtime_error("Wrong usage\n");
@@ -137,7 +181,7 @@ int main(int argc,char* argv[])
 		v.resize(n);
 	}
 
-	if (n==0 || geometryParams.sites==0) {
+	if (n==0 || geometryParams.sites==0 || threads==0) {
 		usage("setMyGeometry");
 		throw std::runtime_error("Wrong usage\n");
 	}
@@ -164,21 +208,27 @@ int main(int argc,char* argv[])
 	RealType sum = 0;
 	for (size_t i=0;i<ne[0];i++) sum += engine.eigenvalue(i);
 	std::cerr<<"Energy="<<dof*sum<<"\n";	
-	size_t sigma = 0;
-	//MatrixType cicj(n,n);
 	size_t norb = (geometryParams.type == GeometryLibraryType::FEAS) ? 2 : 1;
 	for (size_t orbital=0; orbital<norb; orbital++) {
-		for (size_t site = 0; site<n ; site++) {
-			OpNormalFactoryType opNormalFactory(engine);
-			OperatorType& myOp = opNormalFactory(OperatorType::DESTRUCTION,site+orbital*n,sigma);
-			for (size_t site2=0; site2<n; site2++) {
-				HilbertStateType phi = gs;
-				myOp.applyTo(phi);
-				OperatorType& myOp2 = opNormalFactory(OperatorType::CREATION,site2+orbital*n,sigma);
-				myOp2.applyTo(phi);
-				std::cout<<scalarProduct(gs,phi)<<" ";
-				//cicj(site,site2) += scalarProduct(gs,phi);
+		std::vector<std::vector<FieldType> > rows(n);
+		std::vector<RowsType> args(threads);
+		std::vector<pthread_t> ids(threads);
+		for (size_t t=0; t<threads; t++) {
+			RowsType r = {&engine,&gs,n,orbital,t,threads,&rows};
+			args[t] = r;
+			if (threads==1) {
+				computeRows(&args[t]);
+				continue;
 			}
+			if (pthread_create(&ids[t],0,computeRows,&args[t])!=0)
+				throw std::runtime_error("cicj: pthread_create failed\n");
+		}
+		for (size_t t=0; t<threads && threads>1; t++)
+			pthread_join(ids[t],0);
+
+		for (size_t site = 0; site<n ; site++) {
+			for (size_t site2=0; site2<n; site2++)
+				std::cout<<rows[site][site2]<<" ";
 			std::cout<<"\n";
 		}
 		std::cout<<"-------------------------------------------\n";
@@ -11,6 +11,7 @@
 #include "HilbertState.h"
 #include "OneOverZminusH.h"
 #include "DiagonalOperator.h"
+#include "BoundedIndexGenerator.h"
 #include "Tokenizer.h"
 #include "GeometryParameters.h"
 
@@ -28,13 +29,15 @@ typedef FreeFermions::DiagonalOperator<OneOverZminusHType> DiagonalOperatorType;
 typedef FreeFermions::HilbertState<OperatorType,DiagonalOperatorType> HilbertStateType;
 typedef DiagonalOperatorType::FactoryType OpDiagonalFactoryType;
 typedef OperatorType::FactoryType OpNormalFactoryType;
+typedef FreeFermions::AmplitudePruning<RealType> AmplitudePruningType;
 
 enum {DYN_TYPE_0,DYN_TYPE_1};
 
 void usage(const std::string& thisFile)
 {
 	std::cout<<thisFile<<": USAGE IS "<<thisFile<<" ";
-	std::cout<<" -n sites -e electronsUp -g geometry,[leg,filename]\n";
+	std::cout<<" -n sites -e electronsUp -g geometry,[leg,filename]";
+	std::cout<<" [-w margin] [-D]\n";
 }
 
 void setMyGeometry(GeometryParamsType& geometryParams,const std::vector<std::string>& vstr)
@@ -94,10 +97,12 @@ int main(int argc,char *argv[])
 	RealType step = 0;
 	GeometryParamsType geometryParams;
 	size_t dynType = DYN_TYPE_0;
+	RealType margin = -1;
+	bool dryRun = false;
 	
 	geometryParams.type = GeometryLibraryType::CHAIN;
 
-	while ((opt = getopt(argc, argv, "n:e:s:t:o:i:g:d")) != -1) {
+	while ((opt = getopt(argc, argv, "n:e:s:t:o:i:g:dw:D")) != -1) {
 		switch (opt) {
 		case 'n':
 			n = atoi(optarg);
@@ -128,6 +133,12 @@ int main(int argc,char *argv[])
 		case 'd':
 			dynType = DYN_TYPE_1;
 			break;
+		case 'w':
+			margin = atof(optarg);
+			break;
+		case 'D':
+			dryRun = true;
+			break;
 		default: /* '?' */
 			throw std::runtime_error("Wrong usage\n");
 		}
@@ -170,17 +181,37 @@ int main(int argc,char *argv[])
 	std::cout<<"#site2="<<sites[1]<<"\n";
 
 	RealType epsilon = 1e-2;
+	std::vector<ComplexType> zs(total);
+	for (size_t it = 0; it<total; it++)
+		zs[it] = ComplexType(it * step + offset,epsilon);
+
+	// all omegas in one enumeration of the lambdas
+	OpDiagonalFactoryType opDiagonalFactory(engine);
+	int sign = (dynType== DYN_TYPE_1) ? -1 : 1;
+	OneOverZminusHType eih(zs,sign,Eg,engine);
+	// poles farther than margin from the omegas are dropped
+	AmplitudePruningType pruning(0);
+	if (margin>=0) eih.window(margin);
+	DiagonalOperatorType& eihOp = opDiagonalFactory(eih);
+	HilbertStateType phi3 = phi2;
+	eihOp.applyTo(phi3);
+	if (margin>=0) phi3.pruning(&pruning);
+	// what the enumeration would cost, without doing it
+	if (dryRun) {
+		FreeFermions::DryRun<RealType> dry;
+		FreeFermions::dryRun(dry,phi2,phi3);
+		std::cout<<dry;
+		return 0;
+	}
+	std::vector<FieldType> values;
+	scalarProduct(values,phi2,phi3);
+	if (margin>=0) {
+		std::cerr<<"#window terms dropped="<<pruning.skipped();
+		std::cerr<<" error bound="<<pruning.discarded()<<"\n";
+	}
+
 	for (size_t it = 0; it<total; it++) {
-		OpDiagonalFactoryType opDiagonalFactory(engine);
-		RealType omega = it * step + offset;
-		ComplexType z = ComplexType(omega,epsilon);
-		int sign = (dynType== DYN_TYPE_1) ? -1 : 1;
-		OneOverZminusHType eih(z,sign,Eg,engine);
-		DiagonalOperatorType& eihOp = opDiagonalFactory(eih);
-		HilbertStateType phi3 = phi2;
-		eihOp.applyTo(phi3);
-		FieldType tmpC = scalarProduct(phi2,phi3);
-
-		std::cout<<omega<<" "<<std::imag(tmpC)<<" "<<std::real(tmpC)<<"\n";
+		RealType omega = std::real(zs[it]);
+		std::cout<<omega<<" "<<std::imag(values[it])<<" "<<std::real(values[it])<<"\n";
 	}
 }
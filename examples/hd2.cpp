@@ -19,6 +19,7 @@ typedef PsimagLite::ConcurrencySerial<RealType> ConcurrencyType;
 #include "TypeToString.h"
 #include "CreationOrDestructionOp.h"
 #include "HilbertState.h"
+#include "StateFamily.h"
 #include "EtoTheIhTime.h"
 #include "DiagonalOperator.h"
 #include "LibraryOperator.h"
@@ -36,6 +37,8 @@ typedef FreeFermions::CreationOrDestructionOp<EngineType> OperatorType;
 typedef FreeFermions::EToTheIhTime<EngineType> EtoTheIhTimeType;
 typedef FreeFermions::DiagonalOperator<EtoTheIhTimeType> DiagonalOperatorType;
 typedef FreeFermions::HilbertState<OperatorType,DiagonalOperatorType> HilbertStateType;
+typedef FreeFermions::StateFamily<OperatorType,DiagonalOperatorType> StateFamilyType;
+typedef StateFamilyType::State FamilyStateType;
 typedef FreeFermions::LibraryOperator<OperatorType> LibraryOperatorType;
 typedef OperatorType::FactoryType OpNormalFactoryType;
 typedef LibraryOperatorType::FactoryType OpLibFactoryType;
@@ -249,10 +252,12 @@ int main(int argc,char *argv[])
 // 		HilbertStateType savedVector = gs;
 //		FieldType savedValue = 0;
 // 		FieldType sum = 0;
-		std::vector<HilbertStateType*> savedVector(4);
+		// the four vectors share their prefixes
+		StateFamilyType family(engine,ne);
+		std::vector<FamilyStateType> savedVector(4,family.root());
 		
 		for (size_t sigma = 0;sigma<2;sigma++) {
-			HilbertStateType phi = gs;
+			FamilyStateType phi = family.root();
 			LibraryOperatorType& myOp = opLibFactory(
 				LibraryOperatorType::N,sites[0],1-sigma);
 			myOp.applyTo(phi);
@@ -262,29 +267,29 @@ int main(int argc,char *argv[])
 			myOp2.applyTo(phi);
 			
 			for (size_t sigma2 = 0;sigma2 < 2;sigma2++) {
-				savedVector[sigma+sigma2*2] = new HilbertStateType(phi);
+				savedVector[sigma+sigma2*2] = phi;
 				
 				
 				LibraryOperatorType& myOp3 = opLibFactory(
 					LibraryOperatorType::NBAR,sites[1],1-sigma2);
-				myOp3.applyTo(*savedVector[sigma+sigma2*2]);
+				myOp3.applyTo(savedVector[sigma+sigma2*2]);
 				
 				OperatorType& myOp4 = opNormalFactory(
 					OperatorType::DESTRUCTION,sites[1],sigma2);
-				myOp4.applyTo(*savedVector[sigma+sigma2*2]);
+				myOp4.applyTo(savedVector[sigma+sigma2*2]);
 				
 				if (verbose) std::cerr<<"Applying exp(iHt)\n";
-				eihOp.applyTo(*savedVector[sigma+sigma2*2]);
+				eihOp.applyTo(savedVector[sigma+sigma2*2]);
 				
 				if (verbose) std::cerr<<"Applying c_{p down}\n";
 				OperatorType& myOp6 = opNormalFactory(
 					OperatorType::DESTRUCTION,sites[2],SPIN_DOWN);
-				myOp6.applyTo(*savedVector[sigma+sigma2*2]);
+				myOp6.applyTo(savedVector[sigma+sigma2*2]);
 				
 				if (verbose) std::cerr<<"Applying c_{p up}\n";
 				OperatorType& myOp7 = opNormalFactory(
 					OperatorType::DESTRUCTION,sites[2],SPIN_UP);
-				myOp7.applyTo(*savedVector[sigma+sigma2*2]);
+				myOp7.applyTo(savedVector[sigma+sigma2*2]);
 				
 // 				if (verbose) std::cerr<<"Adding "<<sigma<<" "<<sigma2<<" "<<it<<"\n";
 // 				
@@ -302,9 +307,8 @@ int main(int argc,char *argv[])
 			size_t sigma = (x & 3);
 			size_t sigma2 = (x & 12);
 			sigma2 >>= 2;
-			sum += scalarProduct(*savedVector[sigma],*savedVector[sigma2]);
+			sum += family.scalarProduct(savedVector[sigma],savedVector[sigma2]);
 		}
-		for (size_t x=0;x<savedVector.size();x++) delete savedVector[x];
 		
 		std::cout<<time<<" "<<(2.0*sum)<<"\n";
 		range.next();
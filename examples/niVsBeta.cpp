@@ -32,37 +32,52 @@ typedef OperatorType::FactoryType OpNormalFactoryType;
 typedef FreeFermions::LibraryOperator<OperatorType> LibraryOperatorType;
 typedef LibraryOperatorType::FactoryType OpLibFactoryType;
 
-void doOneBeta(const EngineType& engine,
-               std::vector<size_t>& ne,
-               OpLibFactoryType& opLibFactory,
-               size_t site,
-               size_t sigma,
-               RealType beta)
+// all betas and all configurations of ne[0] electrons in one batch
+void doBetas(const EngineType& engine,
+             std::vector<size_t>& ne,
+             OpLibFactoryType& opLibFactory,
+             size_t site,
+             size_t sigma,
+             const std::vector<RealType>& betas,
+             ConcurrencyType& concurrency)
 {
-	RealType sum = 0;
-	RealType sum2 = 0;
-	RealType denominator = 0;
 	FreeFermions::Combinations combinations(engine.size(),ne[0]);
-	size_t factorToMakeItSmaller = 1;
+	std::vector<HilbertStateType::OccupationsType> configurations;
 	for (size_t i = 0; i<combinations.size(); ++i) {
-		OpDiagonalFactoryType opDiagonalFactory(engine);
-		EtoTheBetaHType ebh(beta,engine,0);
-		DiagonalOperatorType& eibOp = opDiagonalFactory(ebh);
-		
 		std::vector<size_t> vTmp(engine.size(),0);
 		for (size_t j=0;j<combinations(i).size();++j) vTmp[combinations(i)[j]]=1;
-		std::vector<std::vector<size_t> > occupations(1,vTmp);
-		HilbertStateType thisState(engine,occupations);
-		HilbertStateType phi = thisState;
-		eibOp.applyTo(phi);
-		denominator += scalarProduct(thisState,phi)*factorToMakeItSmaller;
-		LibraryOperatorType& myOp2 = opLibFactory(LibraryOperatorType::N,site,sigma);
-		myOp2.applyTo(phi);
-		sum += scalarProduct(thisState,phi)*factorToMakeItSmaller;
-		myOp2.applyTo(phi);
-		sum2 += scalarProduct(thisState,phi)*factorToMakeItSmaller;
+		configurations.push_back(HilbertStateType::OccupationsType(1,vTmp));
+	}
+
+	OpDiagonalFactoryType opDiagonalFactory(engine);
+	EtoTheBetaHType ebh(betas,engine,0);
+	DiagonalOperatorType& eibOp = opDiagonalFactory(ebh);
+
+	// the occupations are the configurations', given to closeEach
+	HilbertStateType phi(engine,ne);
+	eibOp.applyTo(phi);
+	std::vector<std::vector<RealType> > denominators;
+	phi.closeEach(denominators,configurations,concurrency);
+	LibraryOperatorType& myOp2 = opLibFactory(LibraryOperatorType::N,site,sigma);
+	myOp2.applyTo(phi);
+	std::vector<std::vector<RealType> > sums;
+	phi.closeEach(sums,configurations,concurrency);
+	myOp2.applyTo(phi);
+	std::vector<std::vector<RealType> > sums2;
+	phi.closeEach(sums2,configurations,concurrency);
+	if (!concurrency.root()) return;
+
+	for (size_t b=0;b<betas.size();b++) {
+		RealType sum = 0;
+		RealType sum2 = 0;
+		RealType denominator = 0;
+		for (size_t i = 0; i<configurations.size(); ++i) {
+			denominator += denominators[i][b];
+			sum += sums[i][b];
+			sum2 += sums2[i][b];
+		}
+		std::cout<<betas[b]<<" "<<sum<<" "<<denominator<<" "<<sum/denominator<<" "<<sum2/denominator<<"\n";
 	}
-	std::cout<<beta<<" "<<sum<<" "<<denominator<<" "<<sum/denominator<<" "<<sum2/denominator<<"\n";	
 }
 
 int main(int argc,char *argv[])
@@ -154,9 +169,8 @@ int main(int argc,char *argv[])
 	std::cout<<"#site="<<site<<"\n";
 
 	OpLibFactoryType opLibFactory(engine);
-	for (size_t i=0;i<total;++i) {
-		RealType beta = i*step + offset;
-		doOneBeta(engine,ne,opLibFactory,site,sigma,beta);
-	}
+	std::vector<RealType> betas(total);
+	for (size_t i=0;i<total;++i) betas[i] = i*step + offset;
+	doBetas(engine,ne,opLibFactory,site,sigma,betas,concurrency);
 	delete geometry;
 }
@@ -79,22 +79,20 @@ FieldType phiNpPhi(OpNormalFactoryType& opNormalFactory,const HilbertStateType&
 }
 
 // <phi| | phi>
-FieldType phiPhi(OpNormalFactoryType& opNormalFactory,const HilbertStateType& gs,const std::vector<size_t>& sites,size_t sigma,DiagonalOperatorType& eihOp,const std::vector<ComplexType>& weights)
+FieldType phiPhi(OpNormalFactoryType& opNormalFactory,const HilbertStateType& gs,const std::vector<size_t>& sites,size_t sigma,DiagonalOperatorType& eihOp,const std::vector<ComplexType>& weights,ConcurrencyType& concurrency)
 {
-	FieldType sum = 0;
+	std::vector<HilbertStateType> states(sites.size(),gs);
 	for (size_t i = 0;i<sites.size();i++) {
-		HilbertStateType backvector = gs;
 		OperatorType& cdaggerI = opNormalFactory(OperatorType::CREATION,sites[i],SPIN_UP);
-		cdaggerI.applyTo(backvector);
-		//eihOp.applyTo(backvector);
-		for (size_t j = 0;j<sites.size();j++) {
-				HilbertStateType tmp = gs; 
-				OperatorType& cdaggerJ = opNormalFactory(OperatorType::CREATION,sites[j],SPIN_UP);
-				cdaggerJ.applyTo(tmp);
-				//eihOp.applyTo(tmp);
-				sum += scalarProduct(backvector,tmp)*weights[i]*weights[j];
-		}
+		cdaggerI.applyTo(states[i]);
+		//eihOp.applyTo(states[i]);
 	}
+	PsimagLite::Matrix<FieldType> gram;
+	gramMatrix(gram,states,concurrency);
+	FieldType sum = 0;
+	for (size_t i = 0;i<sites.size();i++)
+		for (size_t j = 0;j<sites.size();j++)
+			sum += gram(i,j)*weights[i]*weights[j];
 	return sum;
 }
 
@@ -139,6 +137,9 @@ int main(int argc,char* argv[])
 	EngineType engine(geometry,concurrency,dof,true);
 	std::vector<size_t> ne(dof,atoi(argv[2])); // n. of up (= n. of  down electrons)
 	HilbertStateType gs(engine,ne);
+	// the contractions don't depend on time, only the first step computes them
+	HilbertStateType::ClosedProductCacheType cache;
+	gs.cache(&cache);
 	RealType sum = 0;
 	for (size_t i=0;i<ne[0];i++) sum += engine.eigenvalue(i);
 	std::cerr<<"Energy="<<dof*sum<<"\n";	
@@ -165,7 +166,7 @@ int main(int argc,char* argv[])
 		OpDiagonalFactoryType opDiagonalFactory(engine);
 		EtoTheIhTimeType eih(time,engine,0);
 		DiagonalOperatorType& eihOp = opDiagonalFactory(eih);
-		FieldType denominator = phiPhi(opNormalFactory,gs,sites,SPIN_UP,eihOp,weights);
+		FieldType denominator = phiPhi(opNormalFactory,gs,sites,SPIN_UP,eihOp,weights,concurrency);
 		std::cout<<time<<" ";
 		for (size_t site = 0; site<n ; site++) {
 			FieldType numerator = phiNpPhi(opNormalFactory,gs,site,sites,SPIN_UP,eihOp,weights);
@@ -183,5 +184,6 @@ int main(int argc,char* argv[])
 		DiagonalOperatorType& h = opDiagonalFactory(hh);
 		std::cout<<phiHPhi(opNormalFactory,gs,sites,h,weights)<<"\n";
 	}
+	std::cerr<<"Cache hit rate="<<cache.hitRate()<<"\n";
 }
 
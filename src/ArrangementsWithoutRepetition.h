@@ -97,6 +97,9 @@ namespace FreeFermions {
 		{
 			if (k==0 || n<k) throw std::runtime_error(
 			  "ArrangementsWithoutRepetition\n");
+			// so that the first increase() gives 0, 1, ..., k-1
+			for (size_t i=0;i<k;i++) data_[i] = i;
+			data_[k-1]--;
 		}
 
 		/*
@@ -0,0 +1,364 @@
+// BEGIN LICENSE BLOCK
+/*
+Copyright (c) 2011 , UT-Battelle, LLC
+All rights reserved
+
+[FreeFermions, Version 1.0.0]
+[by G.A., Oak Ridge National Laboratory]
+
+UT Battelle Open Source Software License 11242008
+
+OPEN SOURCE LICENSE
+
+Subject to the conditions of this License, each
+contributor to this software hereby grants, free of
+charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), a
+perpetual, worldwide, non-exclusive, no-charge,
+royalty-free, irrevocable copyright license to use, copy,
+modify, merge, publish, distribute, and/or sublicense
+copies of the Software.
+
+1. Redistributions of Software must retain the above
+copyright and license notices, this list of conditions,
+and the following disclaimer.  Changes or modifications
+to, or derivative works of, the Software should be noted
+with comments and the contributor and organization's
+name.
+
+2. Neither the names of UT-Battelle, LLC or the
+Department of Energy nor the names of the Software
+contributors may be used to endorse or promote products
+derived from this software without specific prior written
+permission of UT-Battelle.
+
+3. The software and the end-user documentation included
+with the redistribution, with or without modification,
+must include the following acknowledgment:
+
+"This product includes software produced by UT-Battelle,
+LLC under Contract No. DE-AC05-00OR22725  with the
+Department of Energy."
+ 
+*********************************************************
+DISCLAIMER
+
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+COPYRIGHT OWNER, CONTRIBUTORS, UNITED STATES GOVERNMENT,
+OR THE UNITED STATES DEPARTMENT OF ENERGY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+DAMAGE.
+
+NEITHER THE UNITED STATES GOVERNMENT, NOR THE UNITED
+STATES DEPARTMENT OF ENERGY, NOR THE COPYRIGHT OWNER, NOR
+ANY OF THEIR EMPLOYEES, REPRESENTS THAT THE USE OF ANY
+INFORMATION, DATA, APPARATUS, PRODUCT, OR PROCESS
+DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
+
+*********************************************************
+
+
+*/
+// END LICENSE BLOCK
+/** \ingroup DMRG */
+/*@{*/
+
+/*! \file BackendDispatcher.h
+ *
+ * Closes <bra|ket> with HilbertState or with RealSpaceState,
+ * whichever a cost model calibrated on this machine says is cheaper
+ *
+ */
+#ifndef BACKEND_DISPATCHER_H
+#define BACKEND_DISPATCHER_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "HilbertState.h"
+#include "RealSpaceState.h"
+
+namespace FreeFermions {
+
+	//! Seconds per unit of work of each backend, see
+	//! BackendDispatcher::work(); written and read as one
+	//! "name seconds" line per backend, so that calibrations are stored
+	template<typename RealType>
+	class CostProfile {
+	public:
+
+		enum {HILBERT_STATE,REAL_SPACE_STATE,BACKENDS};
+
+		//! Uncalibrated, both backends cost the same per unit of work
+		CostProfile() : seconds_(BACKENDS,1e-8) {}
+
+		const RealType& operator()(size_t backend) const
+		{
+			return seconds_[backend];
+		}
+
+		void set(size_t backend,const RealType& seconds)
+		{
+			seconds_[backend] = seconds;
+		}
+
+		static std::string name(size_t backend)
+		{
+			return (backend==HILBERT_STATE) ? "HilbertState" : "RealSpaceState";
+		}
+
+		void write(std::ostream& os) const
+		{
+			for (size_t i=0;i<BACKENDS;i++) os<<name(i)<<" "<<seconds_[i]<<"\n";
+		}
+
+		void read(std::istream& is)
+		{
+			std::string s;
+			RealType seconds = 0;
+			while (is>>s>>seconds) {
+				size_t i = 0;
+				while (i<BACKENDS && name(i)!=s) i++;
+				if (i==BACKENDS)
+					throw std::runtime_error("CostProfile::read(): "
+					                         "unknown backend " + s + "\n");
+				seconds_[i] = seconds;
+			}
+		}
+
+	private:
+
+		std::vector<RealType> seconds_;
+	}; // CostProfile
+
+	//! <bra|ket> for bra and ket the Fermi seas of ne1 and ne2 with
+	//! ops1 and ops2 applied in order, as scalarProduct(bra,ket)
+	//! Only C's and D's; with diagonal operators use HilbertState
+	template<typename CorDOperatorType>
+	class BackendDispatcher {
+		typedef typename CorDOperatorType::EngineType EngineType;
+		typedef typename CorDOperatorType::RealType RealType;
+		typedef typename CorDOperatorType::FieldType FieldType;
+
+		enum {CREATION = CorDOperatorType::CREATION,
+		       DESTRUCTION = CorDOperatorType::DESTRUCTION
+		};
+
+	public:
+		typedef CostProfile<RealType> CostProfileType;
+		typedef HilbertState<CorDOperatorType> HilbertStateType;
+		typedef RealSpaceState<CorDOperatorType> RealSpaceStateType;
+		typedef std::vector<const CorDOperatorType*> OperatorsType;
+
+		enum {HILBERT_STATE = CostProfileType::HILBERT_STATE,
+		      REAL_SPACE_STATE = CostProfileType::REAL_SPACE_STATE,
+		      BACKENDS = CostProfileType::BACKENDS
+		};
+
+		//! Each choice is logged to log, if any, with its predicted and
+		//! actual times
+		BackendDispatcher(const EngineType& engine,
+		                  const CostProfileType& profile,
+		                  std::ostream* log = 0)
+		: engine_(engine),profile_(profile),log_(log),
+		  backend_(HILBERT_STATE),predicted_(0),actual_(0)
+		{}
+
+		FieldType scalarProduct(const std::vector<size_t>& ne1,
+		                        const OperatorsType& ops1,
+		                        const std::vector<size_t>& ne2,
+		                        const OperatorsType& ops2)
+		{
+			backend_ = choose(ne1,ops1,ne2,ops2);
+			predicted_ = predict(backend_,ne1,ops1,ne2,ops2);
+			RealType start = DryRun<RealType>::now();
+			FieldType value = close(backend_,ne1,ops1,ne2,ops2);
+			actual_ = DryRun<RealType>::now() - start;
+			if (log_) {
+				*log_<<"#BackendDispatcher: "<<CostProfileType::name(backend_);
+				*log_<<" predicted="<<predicted_<<"s actual="<<actual_<<"s\n";
+			}
+			return value;
+		}
+
+		//! The supported backend of least predicted time
+		size_t choose(const std::vector<size_t>& ne1,
+		              const OperatorsType& ops1,
+		              const std::vector<size_t>& ne2,
+		              const OperatorsType& ops2) const
+		{
+			size_t best = HILBERT_STATE;
+			for (size_t i=0;i<BACKENDS;i++) {
+				if (!supports(i)) continue;
+				if (predict(i,ne1,ops1,ne2,ops2)<predict(best,ne1,ops1,ne2,ops2))
+					best = i;
+			}
+			return best;
+		}
+
+		RealType predict(size_t backend,
+		                 const std::vector<size_t>& ne1,
+		                 const OperatorsType& ops1,
+		                 const std::vector<size_t>& ne2,
+		                 const OperatorsType& ops2) const
+		{
+			return profile_(backend)*work(backend,ne1,ops1,ne2,ops2);
+		}
+
+		//! HilbertState: per flavor, size^c lambda tuples times c!
+		//! permutations, each of the length of the string, for the c C's
+		//! left after pouring; RealSpaceState: per state, the C(n,k) terms
+		//! of its Slater determinant times k! permutations of k factors,
+		//! k = min(ne,n-ne), then each term once per operator and the sort
+		RealType work(size_t backend,
+		              const std::vector<size_t>& ne1,
+		              const OperatorsType& ops1,
+		              const std::vector<size_t>& ne2,
+		              const OperatorsType& ops2) const
+		{
+			RealType n = engine_.size();
+			RealType total = 0;
+			if (backend==REAL_SPACE_STATE)
+				return slater(ne1[0],ops1.size()) + slater(ne2[0],ops2.size());
+
+			RealType length = ops1.size() + ops2.size() + 1;
+			for (size_t sigma=0;sigma<ne1.size();sigma++) {
+				// the bra's operators are poured in transposed
+				size_t c = count(ops2,CREATION,sigma) + count(ops1,DESTRUCTION,sigma);
+				RealType x = length;
+				for (size_t i=0;i<c;i++) x *= n*(i+1);
+				total += x;
+			}
+			return total;
+		}
+
+		bool supports(size_t backend) const
+		{
+			if (backend==HILBERT_STATE) return true;
+			return (engine_.dof()==1 &&
+			        realSpace(static_cast<const FieldType*>(0)));
+		}
+
+		//! Times one small query on each backend, repeated for at least
+		//! minimum seconds, and sets profile to seconds per unit of work
+		//! The query is c^\dagger_1 c_0 on a sea of up to two electrons
+		void calibrate(CostProfileType& profile,RealType minimum = 0.05) const
+		{
+			typename CorDOperatorType::FactoryType factory(engine_);
+			size_t n = engine_.size();
+			std::vector<size_t> ne(engine_.dof(),std::min(size_t(2),n/2));
+			OperatorsType none;
+			OperatorsType ops;
+			ops.push_back(&factory(DESTRUCTION,0,0));
+			ops.push_back(&factory(CREATION,(n>1) ? 1 : 0,0));
+			for (size_t i=0;i<BACKENDS;i++) {
+				if (!supports(i)) continue;
+				size_t repetitions = 0;
+				RealType start = DryRun<RealType>::now();
+				RealType elapsed = 0;
+				do {
+					close(i,ne,none,ne,ops);
+					repetitions++;
+					elapsed = DryRun<RealType>::now() - start;
+				} while (elapsed<minimum);
+				profile.set(i,elapsed/(repetitions*work(i,ne,none,ne,ops)));
+			}
+		}
+
+		//! The backend of the last scalarProduct() and its times
+		size_t backend() const { return backend_; }
+
+		const RealType& predicted() const { return predicted_; }
+
+		const RealType& actual() const { return actual_; }
+
+	private:
+
+		FieldType close(size_t backend,
+		                const std::vector<size_t>& ne1,
+		                const OperatorsType& ops1,
+		                const std::vector<size_t>& ne2,
+		                const OperatorsType& ops2) const
+		{
+			if (backend==REAL_SPACE_STATE)
+				return closeRealSpace(ne1,ops1,ne2,ops2,
+				                      static_cast<const FieldType*>(0));
+			HilbertStateType bra(engine_,ne1);
+			HilbertStateType ket(engine_,ne2);
+			for (size_t i=0;i<ops1.size();i++) bra.pushInto(*ops1[i]);
+			for (size_t i=0;i<ops2.size();i++) ket.pushInto(*ops2[i]);
+			return FreeFermions::scalarProduct(bra,ket);
+		}
+
+		// RealSpaceState is for real fields only
+		FieldType closeRealSpace(const std::vector<size_t>& ne1,
+		                         const OperatorsType& ops1,
+		                         const std::vector<size_t>& ne2,
+		                         const OperatorsType& ops2,
+		                         const RealType*) const
+		{
+			RealSpaceStateType bra(engine_,ne1);
+			RealSpaceStateType ket(engine_,ne2);
+			for (size_t i=0;i<ops1.size();i++) bra.pushInto(*ops1[i]);
+			for (size_t i=0;i<ops2.size();i++) ket.pushInto(*ops2[i]);
+			return FreeFermions::scalarProduct(bra,ket);
+		}
+
+		FieldType closeRealSpace(const std::vector<size_t>&,
+		                         const OperatorsType&,
+		                         const std::vector<size_t>&,
+		                         const OperatorsType&,
+		                         const std::complex<RealType>*) const
+		{
+			throw std::runtime_error("BackendDispatcher: "
+			                         "RealSpaceState needs a real field\n");
+		}
+
+		static bool realSpace(const RealType*) { return true; }
+
+		static bool realSpace(const std::complex<RealType>*) { return false; }
+
+		// a Slater determinant in real space, with operators applied
+		RealType slater(size_t ne,size_t operators) const
+		{
+			size_t n = engine_.size();
+			size_t k = (2*ne>n) ? n - ne : ne;
+			RealType terms = 1;
+			RealType permutations = 1;
+			for (size_t i=0;i<k;i++) {
+				terms *= RealType(n-i)/(i+1);
+				permutations *= (i+1);
+			}
+			return terms*(permutations*k + operators + log(terms) + 1);
+		}
+
+		static size_t count(const OperatorsType& ops,size_t type,size_t sigma)
+		{
+			size_t c = 0;
+			for (size_t i=0;i<ops.size();i++)
+				if (ops[i]->type()==type && ops[i]->sigma()==sigma) c++;
+			return c;
+		}
+
+		const EngineType& engine_;
+		const CostProfileType& profile_;
+		std::ostream* log_;
+		size_t backend_;
+		RealType predicted_;
+		RealType actual_;
+	}; // BackendDispatcher
+} // namespace FreeFermions
+
+/*@}*/
+#endif // BACKEND_DISPATCHER_H
@@ -0,0 +1,379 @@
+// BEGIN LICENSE BLOCK
+/*
+Copyright (c) 2011 , UT-Battelle, LLC
+All rights reserved
+
+[FreeFermions, Version 1.0.0]
+[by G.A., Oak Ridge National Laboratory]
+
+UT Battelle Open Source Software License 11242008
+
+OPEN SOURCE LICENSE
+
+Subject to the conditions of this License, each
+contributor to this software hereby grants, free of
+charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), a
+perpetual, worldwide, non-exclusive, no-charge,
+royalty-free, irrevocable copyright license to use, copy,
+modify, merge, publish, distribute, and/or sublicense
+copies of the Software.
+
+1. Redistributions of Software must retain the above
+copyright and license notices, this list of conditions,
+and the following disclaimer.  Changes or modifications
+to, or derivative works of, the Software should be noted
+with comments and the contributor and organization's
+name.
+
+2. Neither the names of UT-Battelle, LLC or the
+Department of Energy nor the names of the Software
+contributors may be used to endorse or promote products
+derived from this software without specific prior written
+permission of UT-Battelle.
+
+3. The software and the end-user documentation included
+with the redistribution, with or without modification,
+must include the following acknowledgment:
+
+"This product includes software produced by UT-Battelle,
+LLC under Contract No. DE-AC05-00OR22725  with the
+Department of Energy."
+ 
+*********************************************************
+DISCLAIMER
+
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+COPYRIGHT OWNER, CONTRIBUTORS, UNITED STATES GOVERNMENT,
+OR THE UNITED STATES DEPARTMENT OF ENERGY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+DAMAGE.
+
+NEITHER THE UNITED STATES GOVERNMENT, NOR THE UNITED
+STATES DEPARTMENT OF ENERGY, NOR THE COPYRIGHT OWNER, NOR
+ANY OF THEIR EMPLOYEES, REPRESENTS THAT THE USE OF ANY
+INFORMATION, DATA, APPARATUS, PRODUCT, OR PROCESS
+DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
+
+*********************************************************
+
+
+*/
+// END LICENSE BLOCK
+/** \ingroup DMRG */
+/*@{*/
+
+/*! \file BilinearOperator.h
+ *
+ * sum_{ij} A_{ij} c^dagger_i c_j (or c_j c^dagger_i) for one flavor,
+ * kept in the eigenbasis as one matrix if it has many terms
+ *
+ */
+#ifndef BILINEAR_OPERATOR_H
+#define BILINEAR_OPERATOR_H
+
+#include "Complex.h" // in PsimagLite
+#include "Matrix.h" // in PsimagLite
+#include "OperatorFactory.h"
+#include "SharedPointer.h"
+
+namespace FreeFermions {
+
+	template<typename CorDOperatorType>
+	class BilinearOperator {
+		typedef BilinearOperator<CorDOperatorType> ThisType;
+		typedef OperatorFactory<CorDOperatorType> OpNormalFactoryType;
+
+		struct Term {
+			Term(size_t i1,size_t j1,const typename CorDOperatorType::FieldType& a1)
+			: i(i1),j(j1),a(a1)
+			{}
+
+			size_t i;
+			size_t j;
+			typename CorDOperatorType::FieldType a;
+		};
+
+	public:
+		typedef typename CorDOperatorType::EngineType EngineType;
+		typedef typename CorDOperatorType::RealType RealType;
+		typedef typename CorDOperatorType::FieldType FieldType;
+		typedef OperatorFactory<ThisType> FactoryType;
+		typedef PsimagLite::Matrix<FieldType> MatrixType;
+
+		// NORMAL is sum A_{ij} c^dagger_i c_j, ANTINORMAL sum A_{ij} c_j c^dagger_i
+		enum {NORMAL,ANTINORMAL};
+
+		// operators with up to this many terms, as N and NBAR, have
+		// their amplitudes summed when asked for, not in an n x n matrix
+		enum {TERMS_ON_DEMAND = 8};
+
+		enum {CREATION = CorDOperatorType::CREATION,
+		      DESTRUCTION = CorDOperatorType::DESTRUCTION};
+
+		friend class OperatorFactory<ThisType>;
+
+		//! What the factory makes a BilinearOperator of
+		class Terms {
+		public:
+			Terms(const EngineType& engine,size_t type,size_t sigma)
+			: engine_(engine),type_(type),sigma_(sigma)
+			{}
+
+			//! Adds a A_{ij}
+			void add(size_t i,size_t j,const FieldType& a)
+			{
+				terms_.push_back(Term(i,j,a));
+			}
+
+		private:
+			friend class BilinearOperator<CorDOperatorType>;
+
+			const EngineType& engine_;
+			size_t type_;
+			size_t sigma_;
+			std::vector<Term> terms_;
+		};
+
+		size_t type() const { return type_; }
+
+		size_t sigma() const { return sigma_; }
+
+		//! True if it changes the crystal momentum by a definite q,
+		//! in units of 2pi/engine().cells(), see Engine::momentum()
+		bool transfer(size_t& q) const
+		{
+			if (!hasTransfer_) return false;
+			size_t cells = engine_.cells();
+			q = (transposed_) ? (cells-transfer_) % cells : transfer_;
+			return true;
+		}
+
+		const EngineType& engine() const { return engine_; }
+
+		//! Type of the operator applied first
+		size_t first() const { return (type_==NORMAL) ? DESTRUCTION : CREATION; }
+
+		//! Amplitude of c^dagger_lambda c_lambda2, sum U_{i lambda} A_{ij} U*_{j lambda2}
+		FieldType operator()(size_t lambda,size_t lambda2) const
+		{
+			if (transposed_) return std::conj(element(lambda2,lambda));
+			return element(lambda,lambda2);
+		}
+
+		//! The dagger is the same kind of operator with A^dagger
+		void transpose()
+		{
+			transposed_ = !transposed_;
+			makePair();
+		}
+
+		//! Appends what defines this operator, or its transpose, to key
+		//! but for its sigma, as for the index of a CorD
+		template<typename KeyType>
+		void key(KeyType& key,bool transposed) const
+		{
+			key.append(type_);
+			bool dagger = (transposed!=transposed_);
+			for (size_t k=0;k<terms_.size();k++) {
+				const Term& t = terms_[k];
+				key.append((dagger) ? t.j : t.i);
+				key.append((dagger) ? t.i : t.j);
+				key.append((dagger) ? std::conj(t.a) : t.a);
+			}
+		}
+
+		template<typename SomeStateType>
+		void applyTo(SomeStateType& state) const
+		{
+			state.pushInto(*this);
+		}
+
+		//! Pushes the C and D of a one-term operator, for states
+		//! that know only about C's and D's
+		template<typename SomeStateType>
+		void pushPairInto(SomeStateType& state) const
+		{
+			if (!creation_)
+				throw std::runtime_error("BilinearOperator::pushPairInto(): "
+				                         "only for one term\n");
+			if (first()==DESTRUCTION) {
+				state.pushInto(*destruction_);
+				state.pushInto(*creation_);
+			} else {
+				state.pushInto(*creation_);
+				state.pushInto(*destruction_);
+			}
+		}
+
+	private:
+
+		//! n_site for NORMAL and 1-n_site for ANTINORMAL
+		BilinearOperator(const EngineType& engine,
+		                 size_t type,
+		                 size_t site,
+		                 size_t sigma)
+		: engine_(engine),
+		  type_(type),
+		  sigma_(sigma),
+		  transposed_(false),
+		  opNormalFactory_(engine),
+		  creation_(0),
+		  destruction_(0),
+		  hasTransfer_(false),
+		  transfer_(0)
+		{
+			terms_.push_back(Term(site,site,1.0));
+			init();
+		}
+
+		BilinearOperator(const Terms& terms)
+		: engine_(terms.engine_),
+		  type_(terms.type_),
+		  sigma_(terms.sigma_),
+		  terms_(terms.terms_),
+		  transposed_(false),
+		  opNormalFactory_(terms.engine_),
+		  creation_(0),
+		  destruction_(0),
+		  hasTransfer_(false),
+		  transfer_(0)
+		{
+			init();
+		}
+
+		BilinearOperator(const ThisType* x)
+		: engine_(x->engine_),
+		  type_(x->type_),
+		  sigma_(x->sigma_),
+		  terms_(x->terms_),
+		  rotated_(x->rotated_),
+		  transposed_(x->transposed_),
+		  opNormalFactory_(x->engine_),
+		  creation_(0),
+		  destruction_(0),
+		  hasTransfer_(x->hasTransfer_),
+		  transfer_(x->transfer_)
+		{
+			makePair();
+		}
+
+		BilinearOperator(const ThisType& x)
+		{
+			throw std::runtime_error(
+			  "BilinearOperator::copyCtor: Don't even think of coming here\n");
+		}
+
+		ThisType& operator=(const ThisType& x)
+		{
+			throw std::runtime_error(
+			  "BilinearOperator::assignmentOp: Don't even think of coming here\n");
+		}
+
+		// few terms cost O(1) to make; many terms are rotated into a
+		// matrix, and so are those that could change the momentum by a
+		// definite q, which takes at least one term per cell
+		void init()
+		{
+			makePair();
+			bool periodic = (engine_.hasMomenta() &&
+			                 terms_.size()>=engine_.cells());
+			if (terms_.size()<=TERMS_ON_DEMAND && !periodic) return;
+			size_t n = engine_.size();
+			MatrixType* m = new MatrixType(n,n);
+			for (size_t k=0;k<terms_.size();k++) {
+				const Term& t = terms_[k];
+				for (size_t lambda=0;lambda<n;lambda++) {
+					FieldType x = t.a*engine_.eigenvector(t.i,lambda);
+					for (size_t lambda2=0;lambda2<n;lambda2++)
+						(*m)(lambda,lambda2) +=
+						      x*std::conj(engine_.eigenvector(t.j,lambda2));
+				}
+			}
+			findTransfer(*m);
+			rotated_ = SharedPointer<MatrixType>(m);
+		}
+
+		FieldType element(size_t lambda,size_t lambda2) const
+		{
+			if (rotated_.get()) return (*rotated_)(lambda,lambda2);
+			FieldType sum = 0;
+			for (size_t k=0;k<terms_.size();k++) {
+				const Term& t = terms_[k];
+				sum += t.a*engine_.eigenvector(t.i,lambda)*
+				       std::conj(engine_.eigenvector(t.j,lambda2));
+			}
+			return sum;
+		}
+
+		// if all the elements that aren't roundoff change the momentum
+		// by the same q, the others are set to exactly zero
+		void findTransfer(MatrixType& m)
+		{
+			if (!engine_.hasMomenta()) return;
+			size_t n = engine_.size();
+			size_t cells = engine_.cells();
+			RealType max = 0;
+			for (size_t lambda=0;lambda<n;lambda++)
+				for (size_t lambda2=0;lambda2<n;lambda2++)
+					if (std::abs(m(lambda,lambda2))>max)
+						max = std::abs(m(lambda,lambda2));
+			size_t q = cells;
+			for (size_t lambda=0;lambda<n;lambda++) {
+				for (size_t lambda2=0;lambda2<n;lambda2++) {
+					if (std::abs(m(lambda,lambda2))<=1e-10*max) continue;
+					size_t q2 = (engine_.momentum(lambda)+cells-
+					             engine_.momentum(lambda2)) % cells;
+					if (q==cells) q = q2;
+					if (q2!=q) return;
+				}
+			}
+			if (q==cells) return;
+			for (size_t lambda=0;lambda<n;lambda++) {
+				for (size_t lambda2=0;lambda2<n;lambda2++) {
+					size_t q2 = (engine_.momentum(lambda)+cells-
+					             engine_.momentum(lambda2)) % cells;
+					if (q2!=q) m(lambda,lambda2) = 0;
+				}
+			}
+			hasTransfer_ = true;
+			transfer_ = q;
+		}
+
+		void makePair()
+		{
+			if (terms_.size()!=1 || terms_[0].a!=FieldType(1.0)) return;
+			// the dagger of c^dagger_i c_j is c^dagger_j c_i
+			size_t i = (transposed_) ? terms_[0].j : terms_[0].i;
+			size_t j = (transposed_) ? terms_[0].i : terms_[0].j;
+			creation_ = &opNormalFactory_(CREATION,i,sigma_);
+			destruction_ = &opNormalFactory_(DESTRUCTION,j,sigma_);
+		}
+
+		const EngineType& engine_;
+		size_t type_;
+		size_t sigma_;
+		std::vector<Term> terms_;
+		SharedPointer<MatrixType> rotated_;
+		bool transposed_;
+		OpNormalFactoryType opNormalFactory_;
+		const CorDOperatorType* creation_;
+		const CorDOperatorType* destruction_;
+		bool hasTransfer_;
+		size_t transfer_;
+	}; // BilinearOperator
+} // namespace FreeFermions
+
+/*@}*/
+#endif // BILINEAR_OPERATOR_H
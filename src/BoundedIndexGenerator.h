@@ -0,0 +1,271 @@
+// BEGIN LICENSE BLOCK
+/*
+Copyright (c) 2011 , UT-Battelle, LLC
+All rights reserved
+
+[FreeFermions, Version 1.0.0]
+[by G.A., Oak Ridge National Laboratory]
+
+UT Battelle Open Source Software License 11242008
+
+OPEN SOURCE LICENSE
+
+Subject to the conditions of this License, each
+contributor to this software hereby grants, free of
+charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), a
+perpetual, worldwide, non-exclusive, no-charge,
+royalty-free, irrevocable copyright license to use, copy,
+modify, merge, publish, distribute, and/or sublicense
+copies of the Software.
+
+1. Redistributions of Software must retain the above
+copyright and license notices, this list of conditions,
+and the following disclaimer.  Changes or modifications
+to, or derivative works of, the Software should be noted
+with comments and the contributor and organization's
+name.
+
+2. Neither the names of UT-Battelle, LLC or the
+Department of Energy nor the names of the Software
+contributors may be used to endorse or promote products
+derived from this software without specific prior written
+permission of UT-Battelle.
+
+3. The software and the end-user documentation included
+with the redistribution, with or without modification,
+must include the following acknowledgment:
+
+"This product includes software produced by UT-Battelle,
+LLC under Contract No. DE-AC05-00OR22725  with the
+Department of Energy."
+ 
+*********************************************************
+DISCLAIMER
+
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+COPYRIGHT OWNER, CONTRIBUTORS, UNITED STATES GOVERNMENT,
+OR THE UNITED STATES DEPARTMENT OF ENERGY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+DAMAGE.
+
+NEITHER THE UNITED STATES GOVERNMENT, NOR THE UNITED
+STATES DEPARTMENT OF ENERGY, NOR THE COPYRIGHT OWNER, NOR
+ANY OF THEIR EMPLOYEES, REPRESENTS THAT THE USE OF ANY
+INFORMATION, DATA, APPARATUS, PRODUCT, OR PROCESS
+DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
+
+*********************************************************
+
+
+*/
+// END LICENSE BLOCK
+/** \ingroup DMRG */
+/*@{*/
+
+/*! \file BoundedIndexGenerator.h
+ *
+ * Like IndexGenerator, but each index runs over the levels of its
+ * own sparse list, largest amplitude first, and a branch is cut as
+ * soon as the bound of its products falls below a tolerance
+ *
+ */
+#ifndef BOUNDED_INDEX_GENERATOR_H
+#define BOUNDED_INDEX_GENERATOR_H
+
+#include <vector>
+#include <algorithm>
+#include "Complex.h" // in PsimagLite
+
+namespace FreeFermions {
+
+	//! Weight thrown away by amplitude pruning, see HilbertState::pruning()
+	//! Not thread safe
+	template<typename RealType>
+	class AmplitudePruning {
+	public:
+
+		AmplitudePruning(const RealType& tolerance)
+		: tolerance_(tolerance),discarded_(0),skipped_(0)
+		{}
+
+		//! Terms whose amplitudes are bound by less than this are skipped
+		const RealType& tolerance() const { return tolerance_; }
+
+		void discard(const RealType& weight,size_t terms)
+		{
+			discarded_ += weight;
+			skipped_ += terms;
+		}
+
+		//! Bound of the sum of |amplitude| of the skipped terms,
+		//! before diagonal operators and signs, or with the bound of the
+		//! diagonal operator for terms dropped by an energy window
+		const RealType& discarded() const { return discarded_; }
+
+		//! Number of lambda tuples or permutations skipped
+		size_t skipped() const { return skipped_; }
+
+		void clear()
+		{
+			discarded_ = 0;
+			skipped_ = 0;
+		}
+
+	private:
+
+		RealType tolerance_;
+		RealType discarded_;
+		size_t skipped_;
+	}; // AmplitudePruning
+
+	template<typename RealType>
+	class BoundedIndexGenerator {
+
+		typedef std::pair<RealType,size_t> BoundAndLevelType;
+
+		struct Larger {
+			bool operator()(const BoundAndLevelType& a,
+			                const BoundAndLevelType& b) const
+			{
+				return (a.first>b.first);
+			}
+		};
+
+	public:
+		typedef size_t value_type;
+
+		//! bounds[i][lambda] bounds the amplitude of index i at lambda,
+		//! and rest bounds everything else; levels bound by zero are dropped
+		BoundedIndexGenerator(const std::vector<std::vector<RealType> >& bounds,
+		                      const RealType& rest,
+		                      AmplitudePruning<RealType>& pruning)
+		: levels_(bounds.size()),
+		  bounds_(bounds.size()),
+		  tails_(bounds.size()),
+		  positions_(bounds.size(),0),
+		  data_(bounds.size(),0),
+		  rest_(rest),
+		  pruning_(pruning),
+		  valid_(true)
+		{
+			for (size_t i=0;i<bounds.size();i++) {
+				std::vector<BoundAndLevelType> sorted;
+				for (size_t lambda=0;lambda<bounds[i].size();lambda++) {
+					if (bounds[i][lambda]==0) continue;
+					sorted.push_back(BoundAndLevelType(bounds[i][lambda],lambda));
+				}
+				std::stable_sort(sorted.begin(),sorted.end(),Larger());
+				tails_[i].resize(sorted.size()+1,0);
+				for (size_t p=sorted.size();p>0;p--)
+					tails_[i][p-1] = tails_[i][p] + sorted[p-1].first;
+				for (size_t p=0;p<sorted.size();p++) {
+					bounds_[i].push_back(sorted[p].first);
+					levels_[i].push_back(sorted[p].second);
+				}
+				if (sorted.size()==0) valid_ = false;
+			}
+			if (!valid_) return;
+			for (size_t i=0;i<data_.size();i++) data_[i] = levels_[i][0];
+			if (bound(data_.size(),0,rest_)>=pruning_.tolerance()) return;
+			discard(data_.size(),0,rest_);
+			valid_ = false;
+		}
+
+		//! False if all tuples were cut, there's nothing to enumerate
+		bool valid() const { return valid_; }
+
+		//! Next tuple above the tolerance, index 0 runs fastest
+		bool increase()
+		{
+			if (!valid_) return false;
+			// product of the bounds of the indices above c
+			RealType high = rest_;
+			std::vector<RealType> highs(data_.size()+1,rest_);
+			for (size_t c=data_.size();c>0;c--) {
+				highs[c-1] = high;
+				high *= bounds_[c-1][positions_[c-1]];
+			}
+
+			for (size_t c=0;c<data_.size();c++) {
+				size_t p = positions_[c]+1;
+				if (p<levels_[c].size() && bound(c,p,highs[c])>=pruning_.tolerance()) {
+					positions_[c] = p;
+					data_[c] = levels_[c][p];
+					for (size_t j=0;j<c;j++) {
+						positions_[j] = 0;
+						data_[j] = levels_[j][0];
+					}
+					return true;
+				}
+				// sorted, so the rest of this index is below tolerance too
+				discard(c,p,highs[c]);
+			}
+			return false;
+		}
+
+		size_t operator[](size_t i) const { return data_[i]; }
+
+		size_t size() const { return data_.size(); }
+
+	private:
+
+		// largest product with index c at position p, below it the first ones
+		RealType bound(size_t c,size_t p,const RealType& high) const
+		{
+			RealType x = high;
+			if (c<data_.size()) x *= bounds_[c][p];
+			for (size_t j=0;j<c;j++) x *= bounds_[j][0];
+			return x;
+		}
+
+		// everything with index c from position p on, whatever is below it
+		void discard(size_t c,size_t p,const RealType& high)
+		{
+			RealType weight = high;
+			size_t terms = 1;
+			if (c<data_.size()) {
+				weight *= tails_[c][p];
+				terms *= levels_[c].size()-p;
+			}
+			for (size_t j=0;j<c;j++) {
+				weight *= tails_[j][0];
+				terms *= levels_[j].size();
+			}
+			if (terms==0) return;
+			pruning_.discard(weight,terms);
+		}
+
+		std::vector<std::vector<size_t> > levels_;
+		std::vector<std::vector<RealType> > bounds_;
+		// tails_[i][p] is the sum of bounds_[i] from p on
+		std::vector<std::vector<RealType> > tails_;
+		std::vector<size_t> positions_;
+		std::vector<size_t> data_;
+		RealType rest_;
+		AmplitudePruning<RealType>& pruning_;
+		bool valid_;
+	}; // BoundedIndexGenerator
+
+	template<typename RealType>
+	std::ostream& operator<<(std::ostream& os,
+	                         const BoundedIndexGenerator<RealType>& ig)
+	{
+		for (size_t i=0;i<ig.size();i++) os<<ig[i]<<" ";
+		return os;
+	}
+} // namespace FreeFermions
+
+/*@}*/
+#endif // BOUNDED_INDEX_GENERATOR_H
@@ -0,0 +1,237 @@
+// BEGIN LICENSE BLOCK
+/*
+Copyright (c) 2011 , UT-Battelle, LLC
+All rights reserved
+
+[FreeFermions, Version 1.0.0]
+[by G.A., Oak Ridge National Laboratory]
+
+UT Battelle Open Source Software License 11242008
+
+OPEN SOURCE LICENSE
+
+Subject to the conditions of this License, each
+contributor to this software hereby grants, free of
+charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), a
+perpetual, worldwide, non-exclusive, no-charge,
+royalty-free, irrevocable copyright license to use, copy,
+modify, merge, publish, distribute, and/or sublicense
+copies of the Software.
+
+1. Redistributions of Software must retain the above
+copyright and license notices, this list of conditions,
+and the following disclaimer.  Changes or modifications
+to, or derivative works of, the Software should be noted
+with comments and the contributor and organization's
+name.
+
+2. Neither the names of UT-Battelle, LLC or the
+Department of Energy nor the names of the Software
+contributors may be used to endorse or promote products
+derived from this software without specific prior written
+permission of UT-Battelle.
+
+3. The software and the end-user documentation included
+with the redistribution, with or without modification,
+must include the following acknowledgment:
+
+"This product includes software produced by UT-Battelle,
+LLC under Contract No. DE-AC05-00OR22725  with the
+Department of Energy."
+ 
+*********************************************************
+DISCLAIMER
+
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+COPYRIGHT OWNER, CONTRIBUTORS, UNITED STATES GOVERNMENT,
+OR THE UNITED STATES DEPARTMENT OF ENERGY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+DAMAGE.
+
+NEITHER THE UNITED STATES GOVERNMENT, NOR THE UNITED
+STATES DEPARTMENT OF ENERGY, NOR THE COPYRIGHT OWNER, NOR
+ANY OF THEIR EMPLOYEES, REPRESENTS THAT THE USE OF ANY
+INFORMATION, DATA, APPARATUS, PRODUCT, OR PROCESS
+DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
+
+*********************************************************
+
+
+*/
+// END LICENSE BLOCK
+/** \ingroup DMRG */
+/*@{*/
+
+/*! \file ClosedProductCache.h
+ *
+ * A bounded cache of closed scalar products, evicting the
+ * least recently used one, and the canonical key it's indexed by
+ *
+ */
+#ifndef CLOSED_PRODUCT_CACHE_H
+#define CLOSED_PRODUCT_CACHE_H
+
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include "Occupations.h"
+
+namespace FreeFermions {
+
+	//! The bytes of everything a closed product depends on
+	class CanonicalKey {
+	public:
+
+		template<typename T>
+		void append(const T& x)
+		{
+			data_.append(reinterpret_cast<const char*>(&x),sizeof(T));
+		}
+
+		//! Occupations go in as their packed bits
+		void append(const Occupations& occupations)
+		{
+			typedef Occupations::WordType WordType;
+			const std::vector<WordType>& words = occupations.words();
+			if (words.size()==0) return;
+			data_.append(reinterpret_cast<const char*>(&words[0]),
+			             words.size()*sizeof(WordType));
+		}
+
+		bool operator<(const CanonicalKey& other) const
+		{
+			return data_<other.data_;
+		}
+
+		bool operator==(const CanonicalKey& other) const
+		{
+			return data_==other.data_;
+		}
+
+	private:
+
+		std::string data_;
+	}; // CanonicalKey
+
+	//! Not thread safe
+	template<typename FieldType>
+	class ClosedProductCache {
+
+		typedef std::list<const CanonicalKey*> ListType;
+
+		struct Entry {
+			FieldType value;
+			// what pruning left out of value, see AmplitudePruning
+			double discarded;
+			size_t skipped;
+			typename ListType::iterator recent;
+		};
+
+		typedef std::map<CanonicalKey,Entry> MapType;
+
+	public:
+
+		ClosedProductCache(size_t capacity = 4096)
+		: capacity_(capacity),hits_(0),misses_(0)
+		{}
+
+		//! Returns true and sets value if key is cached
+		bool find(const CanonicalKey& key,FieldType& value)
+		{
+			double discarded = 0;
+			size_t skipped = 0;
+			return find(key,value,discarded,skipped);
+		}
+
+		//! As find(key,value), and sets what pruning left out of value
+		bool find(const CanonicalKey& key,
+		          FieldType& value,
+		          double& discarded,
+		          size_t& skipped)
+		{
+			typename MapType::iterator it = map_.find(key);
+			if (it==map_.end()) {
+				misses_++;
+				return false;
+			}
+			hits_++;
+			// most recently used go in front
+			recent_.splice(recent_.begin(),recent_,it->second.recent);
+			value = it->second.value;
+			discarded = it->second.discarded;
+			skipped = it->second.skipped;
+			return true;
+		}
+
+		//! discarded and skipped are what pruning left out of value
+		void insert(const CanonicalKey& key,
+		            const FieldType& value,
+		            double discarded = 0,
+		            size_t skipped = 0)
+		{
+			if (capacity_==0) return;
+			typename MapType::iterator it = map_.find(key);
+			if (it!=map_.end()) {
+				it->second.value = value;
+				it->second.discarded = discarded;
+				it->second.skipped = skipped;
+				return;
+			}
+			if (map_.size()==capacity_) {
+				map_.erase(*recent_.back());
+				recent_.pop_back();
+			}
+			it = map_.insert(std::make_pair(key,Entry())).first;
+			recent_.push_front(&(it->first));
+			it->second.value = value;
+			it->second.discarded = discarded;
+			it->second.skipped = skipped;
+			it->second.recent = recent_.begin();
+		}
+
+		void clear()
+		{
+			map_.clear();
+			recent_.clear();
+			hits_ = misses_ = 0;
+		}
+
+		size_t size() const { return map_.size(); }
+
+		size_t capacity() const { return capacity_; }
+
+		size_t hits() const { return hits_; }
+
+		size_t misses() const { return misses_; }
+
+		double hitRate() const
+		{
+			size_t total = hits_ + misses_;
+			return (total==0) ? 0 : double(hits_)/total;
+		}
+
+	private:
+
+		size_t capacity_;
+		size_t hits_;
+		size_t misses_;
+		MapType map_;
+		ListType recent_;
+	}; // ClosedProductCache
+} // namespace FreeFermions
+
+/*@}*/
+#endif // CLOSED_PRODUCT_CACHE_H
@@ -104,8 +104,60 @@ namespace FreeFermions {
 				return backend_(freeOps,loc);
 			}
 
+			//! Number of points of the parameter grid of the backend
+			size_t size() const { return backend_.size(); }
+
+			//! v[i] is this operator for the i-th point of the grid
+			template<typename FreeOperatorsType>
+			void operator()(std::vector<FieldType>& v,
+			                const FreeOperatorsType& freeOps,
+			                size_t loc) const
+			{
+				backend_(v,freeOps,loc);
+			}
+
+			//! Where the backend has its pole, for a state of this energy
+			RealType pole(const RealType& energy) const
+			{
+				return backend_.pole(energy);
+			}
+
+			//! True if the values on independent flavors multiply
+			bool multiplicative() const { return backend_.multiplicative(); }
+
+			//! True if poles outside an energy window are to be dropped
+			bool windowed() const { return backend_.windowed(); }
+
+			//! True if the pole is outside the window, and then bound is
+			//! the largest |value| over the grid it'd have had
+			bool outside(const RealType& pole,RealType& bound) const
+			{
+				return backend_.outside(pole,bound);
+			}
+
+			//! This operator for the first point of the grid at a given pole
+			FieldType value(const RealType& pole) const
+			{
+				return backend_.value(pole);
+			}
+
+			//! v[i] is this operator for the i-th point of the grid at a pole
+			void values(std::vector<FieldType>& v,const RealType& pole) const
+			{
+				backend_.values(v,pole);
+			}
+
 			void transpose() { backend_.transpose(); }
 
+			//! Appends what defines this operator, or its transpose, to key
+			template<typename KeyType>
+			void key(KeyType& key,bool transposed) const
+			{
+				BackendType backend = backend_;
+				if (transposed) backend.transpose();
+				backend.key(key);
+			}
+
 			template<typename SomeStateType>
 			void applyTo(SomeStateType& state) const
 			{
@@ -0,0 +1,202 @@
+// BEGIN LICENSE BLOCK
+/*
+Copyright (c) 2011 , UT-Battelle, LLC
+All rights reserved
+
+[FreeFermions, Version 1.0.0]
+[by G.A., Oak Ridge National Laboratory]
+
+UT Battelle Open Source Software License 11242008
+
+OPEN SOURCE LICENSE
+
+Subject to the conditions of this License, each
+contributor to this software hereby grants, free of
+charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), a
+perpetual, worldwide, non-exclusive, no-charge,
+royalty-free, irrevocable copyright license to use, copy,
+modify, merge, publish, distribute, and/or sublicense
+copies of the Software.
+
+1. Redistributions of Software must retain the above
+copyright and license notices, this list of conditions,
+and the following disclaimer.  Changes or modifications
+to, or derivative works of, the Software should be noted
+with comments and the contributor and organization's
+name.
+
+2. Neither the names of UT-Battelle, LLC or the
+Department of Energy nor the names of the Software
+contributors may be used to endorse or promote products
+derived from this software without specific prior written
+permission of UT-Battelle.
+
+3. The software and the end-user documentation included
+with the redistribution, with or without modification,
+must include the following acknowledgment:
+
+"This product includes software produced by UT-Battelle,
+LLC under Contract No. DE-AC05-00OR22725  with the
+Department of Energy."
+ 
+*********************************************************
+DISCLAIMER
+
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+COPYRIGHT OWNER, CONTRIBUTORS, UNITED STATES GOVERNMENT,
+OR THE UNITED STATES DEPARTMENT OF ENERGY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+DAMAGE.
+
+NEITHER THE UNITED STATES GOVERNMENT, NOR THE UNITED
+STATES DEPARTMENT OF ENERGY, NOR THE COPYRIGHT OWNER, NOR
+ANY OF THEIR EMPLOYEES, REPRESENTS THAT THE USE OF ANY
+INFORMATION, DATA, APPARATUS, PRODUCT, OR PROCESS
+DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
+
+*********************************************************
+
+
+*/
+// END LICENSE BLOCK
+/** \ingroup DMRG */
+/*@{*/
+
+/*! \file DiagonalProduct.h
+ *
+ * A product of diagonal backends at the same place,
+ * like e^{iHt} e^{-beta H} or (z-H)^{-1} e^{-beta H}
+ *
+ */
+#ifndef DIAGONAL_PRODUCT_H
+#define DIAGONAL_PRODUCT_H
+
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include "FreeOperators.h"
+
+namespace FreeFermions {
+	// Factors see the same energy, which is summed once
+	// Nest products for more than two factors
+	template<typename Backend1Type,typename Backend2Type>
+	class DiagonalProduct {
+	public:
+			typedef typename Backend1Type::EngineType EngineType;
+			typedef typename EngineType::RealType RealType;
+			typedef typename EngineType::FieldType FieldType;
+
+			DiagonalProduct(const Backend1Type& backend1,
+			                const Backend2Type& backend2)
+			: backend1_(backend1),backend2_(backend2)
+			{
+				size_t n1 = backend1_.size();
+				size_t n2 = backend2_.size();
+				if (n1!=1 && n2!=1 && n1!=n2)
+					throw std::runtime_error("DiagonalProduct: "
+					                         "grids of different sizes\n");
+			}
+
+			template<typename FreeOperatorsType>
+			FieldType operator()(const FreeOperatorsType& freeOps,
+			                     size_t loc) const
+			{
+				return value(energyAt(freeOps,loc,engine()));
+			}
+
+			//! The factors have poles of their own,
+			//! so the product's argument is the energy itself
+			RealType pole(const RealType& energy) const { return energy; }
+
+			//! Multiplicative on flavors if both factors are
+			bool multiplicative() const
+			{
+				return backend1_.multiplicative() && backend2_.multiplicative();
+			}
+
+			//! Product for the first point of the grids
+			FieldType value(const RealType& energy) const
+			{
+				return backend1_.value(backend1_.pole(energy))*
+				       backend2_.value(backend2_.pole(energy));
+			}
+
+			//! v[i] is the product for the i-th point of the grids,
+			//! a factor with one point applies to all
+			void values(std::vector<FieldType>& v,const RealType& energy) const
+			{
+				if (backend2_.size()==1) {
+					backend1_.values(v,backend1_.pole(energy));
+					multiply(v,backend2_.value(backend2_.pole(energy)));
+					return;
+				}
+				backend2_.values(v,backend2_.pole(energy));
+				if (backend1_.size()==1) {
+					multiply(v,backend1_.value(backend1_.pole(energy)));
+					return;
+				}
+				std::vector<FieldType> v1;
+				backend1_.values(v1,backend1_.pole(energy));
+				for (size_t i=0;i<v.size();i++) v[i] *= v1[i];
+			}
+
+			//! Windows of the factors aren't used, every pole is kept
+			bool windowed() const { return false; }
+
+			bool outside(const RealType&,RealType&) const { return false; }
+
+			size_t size() const
+			{
+				return std::max(backend1_.size(),backend2_.size());
+			}
+
+			template<typename FreeOperatorsType>
+			void operator()(std::vector<FieldType>& v,
+			                const FreeOperatorsType& freeOps,
+			                size_t loc) const
+			{
+				values(v,energyAt(freeOps,loc,engine()));
+			}
+
+			void transpose()
+			{
+				backend1_.transpose();
+				backend2_.transpose();
+			}
+
+			//! Appends what defines this operator to key
+			template<typename KeyType>
+			void key(KeyType& key) const
+			{
+				backend1_.key(key);
+				backend2_.key(key);
+			}
+
+			const EngineType& engine() const { return backend1_.engine(); }
+
+		private:
+
+			static void multiply(std::vector<FieldType>& v,const FieldType& x)
+			{
+				for (size_t i=0;i<v.size();i++) v[i] *= x;
+			}
+
+			Backend1Type backend1_;
+			Backend2Type backend2_;
+	}; // DiagonalProduct
+} // namespace FreeFermions
+
+/*@}*/
+#endif // DIAGONAL_PRODUCT_H
@@ -0,0 +1,159 @@
+// BEGIN LICENSE BLOCK
+/*
+Copyright (c) 2011 , UT-Battelle, LLC
+All rights reserved
+
+[FreeFermions, Version 1.0.0]
+[by G.A., Oak Ridge National Laboratory]
+
+UT Battelle Open Source Software License 11242008
+
+OPEN SOURCE LICENSE
+
+Subject to the conditions of this License, each
+contributor to this software hereby grants, free of
+charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), a
+perpetual, worldwide, non-exclusive, no-charge,
+royalty-free, irrevocable copyright license to use, copy,
+modify, merge, publish, distribute, and/or sublicense
+copies of the Software.
+
+1. Redistributions of Software must retain the above
+copyright and license notices, this list of conditions,
+and the following disclaimer.  Changes or modifications
+to, or derivative works of, the Software should be noted
+with comments and the contributor and organization's
+name.
+
+2. Neither the names of UT-Battelle, LLC or the
+Department of Energy nor the names of the Software
+contributors may be used to endorse or promote products
+derived from this software without specific prior written
+permission of UT-Battelle.
+
+3. The software and the end-user documentation included
+with the redistribution, with or without modification,
+must include the following acknowledgment:
+
+"This product includes software produced by UT-Battelle,
+LLC under Contract No. DE-AC05-00OR22725  with the
+Department of Energy."
+ 
+*********************************************************
+DISCLAIMER
+
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+COPYRIGHT OWNER, CONTRIBUTORS, UNITED STATES GOVERNMENT,
+OR THE UNITED STATES DEPARTMENT OF ENERGY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+DAMAGE.
+
+NEITHER THE UNITED STATES GOVERNMENT, NOR THE UNITED
+STATES DEPARTMENT OF ENERGY, NOR THE COPYRIGHT OWNER, NOR
+ANY OF THEIR EMPLOYEES, REPRESENTS THAT THE USE OF ANY
+INFORMATION, DATA, APPARATUS, PRODUCT, OR PROCESS
+DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
+
+*********************************************************
+
+
+*/
+// END LICENSE BLOCK
+/** \ingroup DMRG */
+/*@{*/
+
+/*! \file DryRun.h
+ *
+ * What a close would cost, estimated without doing it,
+ * see HilbertState::dryRun() and RealSpaceState::dryRun()
+ *
+ */
+#ifndef DRY_RUN_H
+#define DRY_RUN_H
+
+#include <sys/time.h>
+#include <iostream>
+
+namespace FreeFermions {
+
+	//! Expected counts of a query; counts are real, since they can
+	//! overflow any integer long before the query is out of reach
+	template<typename RealType>
+	class DryRun {
+	public:
+
+		DryRun() : tuples_(0),permutations_(0),terms_(0),bytes_(0),seconds_(0)
+		{}
+
+		//! Lambda tuples, or real space arrangements, enumerated
+		const RealType& tuples() const { return tuples_; }
+
+		//! Permutations of those tuples, each a candidate term
+		const RealType& permutations() const { return permutations_; }
+
+		//! Terms that survive momentum, amplitude and sign checks
+		const RealType& terms() const { return terms_; }
+
+		//! Peak memory of the enumeration
+		const RealType& bytes() const { return bytes_; }
+
+		//! Estimated wall time
+		const RealType& seconds() const { return seconds_; }
+
+		//! Sequential parts add up, memory is the largest of them
+		void add(const RealType& tuples,
+		         const RealType& permutations,
+		         const RealType& terms,
+		         const RealType& bytes,
+		         const RealType& seconds)
+		{
+			tuples_ += tuples;
+			permutations_ += permutations;
+			terms_ += terms;
+			if (bytes>bytes_) bytes_ = bytes;
+			seconds_ += seconds;
+		}
+
+		//! Wall clock, for the sampled calibrations
+		static RealType now()
+		{
+			struct timeval tv;
+			gettimeofday(&tv,0);
+			return tv.tv_sec + 1e-6*tv.tv_usec;
+		}
+
+	private:
+
+		RealType tuples_;
+		RealType permutations_;
+		RealType terms_;
+		RealType bytes_;
+		RealType seconds_;
+	}; // DryRun
+
+	template<typename RealType>
+	std::ostream& operator<<(std::ostream& os,const DryRun<RealType>& dry)
+	{
+		os<<"#dryRun tuples="<<dry.tuples();
+		os<<" permutations="<<dry.permutations();
+		os<<" terms="<<dry.terms();
+		os<<" bytes="<<dry.bytes();
+		os<<" seconds="<<dry.seconds()<<"\n";
+		return os;
+	}
+} // namespace FreeFermions
+
+/*@}*/
+#endif // DRY_RUN_H
@@ -86,6 +86,8 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 
 namespace FreeFermions {
 	// All interactions == 0
+	// Const once built: its const members may be called from any number
+	// of threads, so one Engine serves all of them
 	template<typename RealType_,typename FieldType_,typename ConcurrencyType_>
 	class Engine {
 	
@@ -95,13 +97,25 @@ namespace FreeFermions {
 			typedef FieldType_ FieldType;
 			typedef ConcurrencyType_ ConcurrencyType;
 
-			Engine(const PsimagLite::Matrix<FieldType>& geometry,ConcurrencyType& concurrency,size_t dof,bool verbose=false)
+			//! With momenta, degenerate levels of a translation invariant
+			//! lattice are mixed into states of definite momentum, which
+			//! changes what a partly filled shell holds, and so any product
+			//! of such states; without it, levels are only labeled if they
+			//! already have a definite momentum, see hasMomenta()
+			Engine(const PsimagLite::Matrix<FieldType>& geometry,
+			       ConcurrencyType& concurrency,
+			       size_t dof,
+			       bool verbose=false,
+			       bool momenta=false)
 			: concurrency_(concurrency),
 			  dof_(dof),
 			  verbose_(verbose),
-			  eigenvectors_(geometry)
+			  eigenvectors_(geometry),
+			  cells_(0)
 			{
+				size_t cell = translationCell();
 				diagonalize();
+				if (cell>0) findMomenta(cell,momenta);
 				if (verbose_) {
 					std::cerr<<"#Created core "<<eigenvectors_.n_row();
 					std::cerr<<"  times "<<eigenvectors_.n_col()<<"\n";
@@ -123,11 +137,23 @@ namespace FreeFermions {
 			}
 
 			size_t dof() const { return dof_; }
+
+			//! True if the lattice is translation invariant and each
+			//! eigenvector has a crystal momentum
+			bool hasMomenta() const { return cells_>0; }
+
+			//! Number of momenta, the number of unit cells
+			size_t cells() const { return cells_; }
+
+			//! Momentum of eigenvector i, in units of 2pi/cells()
+			size_t momentum(size_t i) const { return momenta_[i]; }
 	
 			size_t size() const { return eigenvalues_.size(); }
 
 			ConcurrencyType& concurrency() { return concurrency_; }
 
+			const ConcurrencyType& concurrency() const { return concurrency_; }
+
 		private:
 		
 			void diagonalize()
@@ -145,11 +171,121 @@ namespace FreeFermions {
 				}
 			}
 
+			// smallest shift x->x+cell (mod sites) that leaves the
+			// hoppings unchanged, 0 if none but the trivial one
+			size_t translationCell() const
+			{
+				const PsimagLite::Matrix<FieldType>& t = eigenvectors_;
+				size_t n = t.n_row();
+				for (size_t cell=1;2*cell<=n;cell++) {
+					if (n % cell!=0) continue;
+					bool invariant = true;
+					for (size_t i=0;i<n && invariant;i++) {
+						for (size_t j=0;j<n;j++) {
+							FieldType x = t((i+cell)%n,(j+cell)%n)-t(i,j);
+							if (std::abs(x)<1e-12) continue;
+							invariant = false;
+							break;
+						}
+					}
+					if (invariant) return cell;
+				}
+				return 0;
+			}
+
+			// degenerate levels are mixed, if rotate, so that they're
+			// eigenvectors of the translation, and then labeled; if any
+			// isn't one, none is labeled
+			void findMomenta(size_t cell,bool rotate)
+			{
+				size_t n = eigenvalues_.size();
+				cells_ = n/cell;
+				momenta_.resize(n);
+				for (size_t i=0;i<n && rotate;) {
+					size_t j = i+1;
+					while (j<n && eigenvalues_[j]-eigenvalues_[i]<1e-10) j++;
+					if (j-i>1) rotateToMomenta(i,j,cell,FieldType());
+					i = j;
+				}
+				for (size_t i=0;i<n;i++) {
+					FieldType phase = 0;
+					for (size_t x=0;x<n;x++)
+						phase += std::conj(eigenvectors_(x,i))*
+						         eigenvectors_((x+cell)%n,i);
+					RealType error = 0;
+					for (size_t x=0;x<n;x++)
+						error += std::abs(eigenvectors_((x+cell)%n,i)-
+						                  phase*eigenvectors_(x,i));
+					if (error>1e-8) {
+						cells_ = 0;
+						momenta_.clear();
+						return;
+					}
+					RealType k = angle(phase)*cells_/(2*M_PI);
+					int m = int(floor(k+0.5));
+					momenta_[i] = (m+cells_) % cells_;
+				}
+			}
+
+			// real eigenvectors have a phase of +1 or -1
+			static RealType angle(const RealType& phase)
+			{
+				return (phase<0) ? M_PI : 0;
+			}
+
+			static RealType angle(const std::complex<RealType>& phase)
+			{
+				return atan2(std::imag(phase),std::real(phase));
+			}
+
+			// real eigenvectors have no complex phases to mix with
+			void rotateToMomenta(size_t,size_t,size_t,const RealType&)
+			{}
+
+			// diagonalizes (T+T^dagger)/2 + gamma (T-T^dagger)/2i in the
+			// levels from i to j, whose eigenvalues differ for each momentum
+			void rotateToMomenta(size_t i,
+			                     size_t j,
+			                     size_t cell,
+			                     const std::complex<RealType>&)
+			{
+				size_t n = eigenvalues_.size();
+				size_t d = j-i;
+				const RealType gamma = 0.5*sqrt(2.0);
+				PsimagLite::Matrix<FieldType> m(d,d);
+				for (size_t a=0;a<d;a++) {
+					for (size_t b=0;b<d;b++) {
+						FieldType forward = 0;
+						FieldType backward = 0;
+						for (size_t x=0;x<n;x++) {
+							FieldType bra = std::conj(eigenvectors_(x,i+a));
+							forward += bra*eigenvectors_((x+cell)%n,i+b);
+							backward += bra*eigenvectors_((x+n-cell)%n,i+b);
+						}
+						m(a,b) = 0.5*(forward+backward) +
+						         gamma*(forward-backward)/FieldType(0,2);
+					}
+				}
+				std::vector<RealType> e;
+				diag(m,e,'V');
+				std::vector<FieldType> v(d);
+				for (size_t x=0;x<n;x++) {
+					for (size_t a=0;a<d;a++) {
+						v[a] = 0;
+						for (size_t b=0;b<d;b++)
+							v[a] += eigenvectors_(x,i+b)*m(b,a);
+					}
+					for (size_t a=0;a<d;a++) eigenvectors_(x,i+a) = v[a];
+				}
+			}
+
 			ConcurrencyType& concurrency_;
 			size_t dof_; // degrees of freedom that are simply repetition (hoppings are diagonal in these)
 			bool verbose_;
 			PsimagLite::Matrix<FieldType> eigenvectors_;
 			std::vector<RealType> eigenvalues_;
+			size_t cells_;
+			std::vector<size_t> momenta_;
 	}; // Engine
 } // namespace FreeFermions 
 
@@ -82,6 +82,9 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 #ifndef E_TO_THE_BETA_H_H
 #define E_TO_THE_BETA_H_H
 
+#include <vector>
+#include "FreeOperators.h"
+
 namespace FreeFermions {
 	// All interactions == 0
 	template<typename EngineType_>
@@ -94,7 +97,16 @@ namespace FreeFermions {
 			EToTheBetaH(RealType beta,
 			              const EngineType& engine,
 			              RealType energyOffset)
-			: beta_(beta),
+			: betas_(1,beta),
+			  engine_(engine),
+			  energyOffset_(energyOffset)
+			{}
+
+			//! One value per beta, in one enumeration
+			EToTheBetaH(const std::vector<RealType>& betas,
+			              const EngineType& engine,
+			              RealType energyOffset)
+			: betas_(betas),
 			  engine_(engine),
 			  energyOffset_(energyOffset)
 			{}
@@ -103,27 +115,62 @@ namespace FreeFermions {
 			FieldType operator()(const FreeOperatorsType& freeOps,
 			                     size_t loc) const
 			{
-				RealType sum = 0;
-				for (size_t i=0;i<loc;i++) {
-// 					if (freeOps[i].type != FreeOperatorsType::CREATION &&
-// 						freeOps[i].type != FreeOperatorsType::DESTRUCTION)
-// 						   continue;
-// 					int sign =  (freeOps[i].type ==
-// 							       FreeOperatorsType::CREATION) ? -1 : 1;
-					if (freeOps[i].type != FreeOperatorsType::CREATION) continue;
-					sum += engine_.eigenvalue(freeOps[i].lambda); //*sign;
-				}
-
-				RealType exponent = -beta_*sum;
-				return exp(exponent);
+				return value(pole(energyAt(freeOps,loc,engine_)));
+			}
+
+			//! What this operator exponentiates, for a state of this energy
+			RealType pole(const RealType& energy) const { return energy; }
+
+			//! e^{-beta H} of independent flavors is the product of theirs
+			bool multiplicative() const { return true; }
+
+			//! This operator for the first beta at a given pole
+			FieldType value(const RealType& pole) const
+			{
+				return exp(-betas_[0]*pole);
+			}
+
+			//! v[i] is this operator for the i-th beta at a given pole
+			void values(std::vector<FieldType>& v,const RealType& pole) const
+			{
+				v.resize(betas_.size());
+				for (size_t i=0;i<betas_.size();i++)
+					v[i] = exp(-betas_[i]*pole);
+			}
+
+			//! No energy window, every pole is kept
+			bool windowed() const { return false; }
+
+			bool outside(const RealType&,RealType&) const { return false; }
+
+			//! Number of points of the beta grid
+			size_t size() const { return betas_.size(); }
+
+			//! v[i] is this operator for the i-th beta
+			template<typename FreeOperatorsType>
+			void operator()(std::vector<FieldType>& v,
+			                const FreeOperatorsType& freeOps,
+			                size_t loc) const
+			{
+				values(v,pole(energyAt(freeOps,loc,engine_)));
 			}
 
-			
 			void transpose() { }
 
+			//! Appends what defines this operator to key
+			template<typename KeyType>
+			void key(KeyType& key) const
+			{
+				key.append(betas_.size());
+				for (size_t i=0;i<betas_.size();i++) key.append(betas_[i]);
+				key.append(energyOffset_);
+			}
+
+			const EngineType& engine() const { return engine_; }
+
 		private:
-			
-			RealType beta_;
+
+			std::vector<RealType> betas_;
 			const EngineType& engine_;
 			RealType energyOffset_;
 	}; // EToTheBetaH
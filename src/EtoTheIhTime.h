@@ -80,11 +80,17 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 #ifndef E_TO_THE_I_H_TIME_H
 #define E_TO_THE_I_H_TIME_H
 
+#include <vector>
+#include "FreeOperators.h"
 
 namespace FreeFermions {
 	// All interactions == 0
 	template<typename EngineType_>
 	class EToTheIhTime {
+
+			// now and then the recurrence starts afresh
+			enum {RESTART = 64};
+
 	public:
 			typedef EngineType_ EngineType;
 			typedef typename EngineType::RealType RealType;
@@ -93,8 +99,18 @@ namespace FreeFermions {
 			EToTheIhTime(RealType time,
 			              const EngineType& engine,
 			              RealType energyOffset) :
-				time_(time),
-				engine_(engine),energyOffset_(energyOffset)
+				times_(1,time),
+				engine_(engine),energyOffset_(energyOffset),uniform_(false)
+			{
+			}
+
+			//! One value per time, in one enumeration
+			EToTheIhTime(const std::vector<RealType>& times,
+			              const EngineType& engine,
+			              RealType energyOffset) :
+				times_(times),
+				engine_(engine),energyOffset_(energyOffset),
+				uniform_(isUniform(times))
 			{
 			}
 
@@ -102,27 +118,96 @@ namespace FreeFermions {
 			FieldType operator()(const FreeOperatorsType& freeOps,
 			                      size_t loc) const
 			{
-				RealType sum = 0;
-				for (size_t i=0;i<loc;i++) {
-					if (freeOps[i].type != FreeOperatorsType::CREATION &&
-						freeOps[i].type != FreeOperatorsType::DESTRUCTION)
-						   continue;
-					int sign =  (freeOps[i].type ==
-							       FreeOperatorsType::CREATION) ? -1 : 1;
-					sum += engine_.eigenvalue(freeOps[i].lambda)*sign;
+				return value(pole(energyAt(freeOps,loc,engine_)));
+			}
+
+			//! What this operator exponentiates, for a state of this energy
+			RealType pole(const RealType& energy) const { return -energy; }
+
+			//! e^{-iHt} of independent flavors is the product of theirs
+			bool multiplicative() const { return true; }
+
+			//! This operator for the first time at a given pole
+			FieldType value(const RealType& pole) const
+			{
+				return exponential(times_[0],pole);
+			}
+
+			//! v[i] is this operator for the i-th time at a given pole
+			//! On uniform grids each value is the previous one times
+			//! e^{-i dt pole}, with no sin or cos in between restarts
+			void values(std::vector<FieldType>& v,const RealType& pole) const
+			{
+				v.resize(times_.size());
+				if (!uniform_) {
+					for (size_t i=0;i<times_.size();i++)
+						v[i] = exponential(times_[i],pole);
+					return;
 				}
-				if (fabs(time_)>1000.0) return sum; 
-				RealType exponent = -time_*sum;
-				return FieldType(cos(exponent),sin(exponent));
+				FieldType step = exponential(times_[1]-times_[0],pole);
+				for (size_t i=0;i<times_.size();i++)
+					v[i] = (i%RESTART==0) ? exponential(times_[i],pole) : v[i-1]*step;
+			}
+
+			//! No energy window, every pole is kept
+			bool windowed() const { return false; }
+
+			bool outside(const RealType&,RealType&) const { return false; }
+
+			//! Number of points of the time grid
+			size_t size() const { return times_.size(); }
+
+			//! v[i] is this operator for the i-th time
+			template<typename FreeOperatorsType>
+			void operator()(std::vector<FieldType>& v,
+			                const FreeOperatorsType& freeOps,
+			                size_t loc) const
+			{
+				values(v,pole(energyAt(freeOps,loc,engine_)));
+			}
+
+			void transpose()
+			{
+				for (size_t i=0;i<times_.size();i++) times_[i] = -times_[i];
+			}
+
+			//! Appends what defines this operator to key
+			template<typename KeyType>
+			void key(KeyType& key) const
+			{
+				key.append(times_.size());
+				for (size_t i=0;i<times_.size();i++) key.append(times_[i]);
+				key.append(energyOffset_);
 			}
 
-			void transpose() { time_ = -time_; }
+			const EngineType& engine() const { return engine_; }
 
 		private:
-			
-			RealType time_;
+
+			static bool isUniform(const std::vector<RealType>& times)
+			{
+				if (times.size()<3) return false;
+				RealType dt = times[1]-times[0];
+				for (size_t i=0;i<times.size();i++) {
+					// the time>1000 convention can't be a recurrence
+					if (fabs(times[i])>1000.0) return false;
+					RealType t = times[0] + i*dt;
+					if (fabs(times[i]-t)>1e-12*(1+fabs(t))) return false;
+				}
+				return true;
+			}
+
+			FieldType exponential(const RealType& time,const RealType& sum) const
+			{
+				if (fabs(time)>1000.0) return sum;
+				RealType exponent = -time*sum;
+				return FieldType(cos(exponent),sin(exponent));
+			}
+
+			std::vector<RealType> times_;
 			const EngineType& engine_;
 			RealType energyOffset_;
+			bool uniform_;
 	}; // EToTheIhTime
 } // namespace Dmrg 
 
@@ -0,0 +1,405 @@
+// BEGIN LICENSE BLOCK
+/*
+Copyright (c) 2011 , UT-Battelle, LLC
+All rights reserved
+
+[FreeFermions, Version 1.0.0]
+[by G.A., Oak Ridge National Laboratory]
+
+UT Battelle Open Source Software License 11242008
+
+OPEN SOURCE LICENSE
+
+Subject to the conditions of this License, each
+contributor to this software hereby grants, free of
+charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), a
+perpetual, worldwide, non-exclusive, no-charge,
+royalty-free, irrevocable copyright license to use, copy,
+modify, merge, publish, distribute, and/or sublicense
+copies of the Software.
+
+1. Redistributions of Software must retain the above
+copyright and license notices, this list of conditions,
+and the following disclaimer.  Changes or modifications
+to, or derivative works of, the Software should be noted
+with comments and the contributor and organization's
+name.
+
+2. Neither the names of UT-Battelle, LLC or the
+Department of Energy nor the names of the Software
+contributors may be used to endorse or promote products
+derived from this software without specific prior written
+permission of UT-Battelle.
+
+3. The software and the end-user documentation included
+with the redistribution, with or without modification,
+must include the following acknowledgment:
+
+"This product includes software produced by UT-Battelle,
+LLC under Contract No. DE-AC05-00OR22725  with the
+Department of Energy."
+ 
+*********************************************************
+DISCLAIMER
+
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+COPYRIGHT OWNER, CONTRIBUTORS, UNITED STATES GOVERNMENT,
+OR THE UNITED STATES DEPARTMENT OF ENERGY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+DAMAGE.
+
+NEITHER THE UNITED STATES GOVERNMENT, NOR THE UNITED
+STATES DEPARTMENT OF ENERGY, NOR THE COPYRIGHT OWNER, NOR
+ANY OF THEIR EMPLOYEES, REPRESENTS THAT THE USE OF ANY
+INFORMATION, DATA, APPARATUS, PRODUCT, OR PROCESS
+DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
+
+*********************************************************
+
+
+*/
+// END LICENSE BLOCK
+/** \ingroup DMRG */
+/*@{*/
+
+/*! \file EvaluationPlan.h
+ *
+ * The operator string of a HilbertState compiled for one flavor,
+ * so that the loop over lambdas does only arithmetic
+ *
+ */
+#ifndef EVALUATION_PLAN_H
+#define EVALUATION_PLAN_H
+
+#include "Complex.h" // in PsimagLite
+#include <vector>
+#include <algorithm>
+
+namespace FreeFermions {
+
+	template<typename CorDOperatorType,
+	         typename OpPointerType,
+	         typename BilinearOperatorType>
+	class EvaluationPlan {
+
+		// a bilinear is a C and a D whose amplitude is one matrix element
+		struct BilinearSlot {
+			BilinearSlot(const BilinearOperatorType* o,size_t c,size_t d)
+			: op(o),creation(c),destruction(d)
+			{}
+
+			const BilinearOperatorType* op;
+			size_t creation;
+			size_t destruction;
+		};
+
+		// a bilinear whose C and D momenta differ by a definite q
+		struct MomentumSlot {
+			MomentumSlot(size_t c,size_t d,size_t q1)
+			: creation(c),destruction(d),q(q1)
+			{}
+
+			size_t creation;
+			size_t destruction;
+			size_t q;
+		};
+
+		typedef typename CorDOperatorType::FieldType FieldType;
+		typedef typename CorDOperatorType::RealType RealType;
+		typedef typename CorDOperatorType::EngineType EngineType;
+
+		enum {CREATION = CorDOperatorType::CREATION,
+		      DESTRUCTION = CorDOperatorType::DESTRUCTION
+		};
+
+		// now and then the running product starts afresh
+		enum {RESTART = 64};
+
+	public:
+
+		// the product of the C amplitudes along the Gray order of the
+		// lambdas, zero factors are counted apart so they divide out
+		struct CreationProduct {
+			FieldType operator()() const { return (zeros>0) ? 0 : nonzero; }
+
+			FieldType nonzero;
+			size_t zeros;
+			size_t steps;
+		};
+
+		EvaluationPlan(const std::vector<OpPointerType>& opPointers,
+		               const std::vector<const CorDOperatorType*>& creations,
+		               const std::vector<const CorDOperatorType*>& destructions,
+		               const std::vector<const BilinearOperatorType*>& bilinears,
+		               size_t sigma)
+		: engine_(0)
+		{
+			// slots are counted as FreeOperators lays out its middle part:
+			// C's and D's of other flavors are left out, diagonals are not
+			size_t slot = 0;
+			for (size_t i=0;i<opPointers.size();i++) {
+				size_t type1 = opPointers[i].type;
+				if (type1!=CREATION && type1!=DESTRUCTION) {
+					diagonalSlots_.push_back(slot++);
+					continue;
+				}
+				if (opPointers[i].sigma!=sigma) continue;
+				size_t index = opPointers[i].index;
+				if (opPointers[i].bilinear) {
+					// its two halves come together, with the same index
+					const BilinearOperatorType* op = bilinears[index];
+					bilinears_.push_back(BilinearSlot(op,
+					                                  creations_.size(),
+					                                  destructions_.size()));
+					size_t q = 0;
+					if (op->transfer(q)) {
+						engine_ = &op->engine();
+						momentumSlots_.push_back(MomentumSlot(creations_.size(),
+						                         destructions_.size(),
+						                         q));
+					}
+					for (size_t j=i;j<i+2;j++) {
+						if (opPointers[j].type==CREATION) {
+							creations_.push_back(0);
+							creationSlots_.push_back(slot++);
+						} else {
+							destructions_.push_back(0);
+							destructionSlots_.push_back(slot++);
+						}
+					}
+					i++;
+					continue;
+				}
+				if (type1==CREATION) {
+					creations_.push_back(creations[index]);
+					creationSlots_.push_back(slot++);
+				} else {
+					destructions_.push_back(destructions[index]);
+					destructionSlots_.push_back(slot++);
+				}
+			}
+		}
+
+		//! Number of C's of this flavor, ie, the number of lambdas
+		size_t creations() const { return creations_.size(); }
+
+		//! Location of the i-th diagonal operator in freeOps
+		template<typename FreeOperatorsType>
+		size_t diagonalLocation(const FreeOperatorsType& freeOps,size_t i) const
+		{
+			return freeOps.middle() + diagonalSlots_[i];
+		}
+
+		//! Energy at the i-th diagonal operator for these lambdas, as
+		//! energyAt() gives after fill(), adding in the same order, but
+		//! with freeOps left as it is
+		template<typename FreeOperatorsType,typename LambdaType,
+		         typename Lambda2Type>
+		RealType diagonalEnergy(const FreeOperatorsType& freeOps,
+		                        const LambdaType& lambda,
+		                        const Lambda2Type& lambda2,
+		                        size_t i,
+		                        const EngineType& engine) const
+		{
+			size_t middle = freeOps.middle();
+			size_t slot = diagonalSlots_[i];
+			RealType energy = freeOps.vacuumEnergy();
+			size_t c = 0;
+			size_t d = 0;
+			while (true) {
+				bool creation = (c<creationSlots_.size() && c<lambda.size() &&
+				                 creationSlots_[c]<slot);
+				bool destruction = (d<destructionSlots_.size() &&
+				                    d<lambda2.size() &&
+				                    destructionSlots_[d]<slot);
+				if (!creation && !destruction) break;
+				if (creation && destruction)
+					creation = (creationSlots_[c]<destructionSlots_[d]);
+				size_t loc = middle + ((creation) ? creationSlots_[c] :
+				                                    destructionSlots_[d]);
+				size_t level = (creation) ? lambda[c++] : lambda2[d++];
+				if (freeOps[loc].type==FreeOperatorsType::CREATION)
+					energy += engine.eigenvalue(level);
+				else
+					energy -= engine.eigenvalue(level);
+			}
+			return energy;
+		}
+
+		//! Writes lambda and lambda2 into the C's and D's of freeOps
+		template<typename FreeOperatorsType,typename LambdaType,
+		         typename Lambda2Type>
+		void fill(FreeOperatorsType& freeOps,
+		          const LambdaType& lambda,
+		          const Lambda2Type& lambda2) const
+		{
+			size_t middle = freeOps.middle();
+			for (size_t i=0;i<creationSlots_.size() && i<lambda.size();i++)
+				freeOps.setLambda(middle + creationSlots_[i],lambda[i]);
+			for (size_t i=0;i<destructionSlots_.size() && i<lambda2.size();i++)
+				freeOps.setLambda(middle + destructionSlots_[i],lambda2[i]);
+		}
+
+		//! Product of the amplitudes of the C's and D's for these lambdas
+		template<typename LambdaType,typename Lambda2Type>
+		FieldType amplitude(const LambdaType& lambda,
+		                    const Lambda2Type& lambda2) const
+		{
+			return creationAmplitude(lambda)*destructionAmplitude(lambda,lambda2);
+		}
+
+		//! Product of the amplitudes of the C's, the same for all lambda2's
+		template<typename LambdaType>
+		FieldType creationAmplitude(const LambdaType& lambda) const
+		{
+			FieldType prod = 1;
+			for (size_t i=0;i<creations_.size() && i<lambda.size();i++)
+				if (creations_[i]) prod *= creations_[i]->operator()(lambda[i]);
+			return prod;
+		}
+
+		//! Product of the amplitudes of the D's and of the bilinears
+		template<typename LambdaType,typename Lambda2Type>
+		FieldType destructionAmplitude(const LambdaType& lambda,
+		                               const Lambda2Type& lambda2) const
+		{
+			FieldType prod = 1;
+			for (size_t i=0;i<destructions_.size() && i<lambda2.size();i++)
+				if (destructions_[i])
+					prod *= destructions_[i]->operator()(lambda2[i]);
+			for (size_t i=0;i<bilinears_.size();i++) {
+				const BilinearSlot& b = bilinears_[i];
+				prod *= b.op->operator()(lambda[b.creation],
+				                         lambda2[b.destruction]);
+			}
+			return prod;
+		}
+
+		//! Starts the running product of the C amplitudes at lambda
+		template<typename LambdaType>
+		void start(CreationProduct& product,const LambdaType& lambda) const
+		{
+			product.nonzero = 1;
+			product.zeros = 0;
+			product.steps = 0;
+			for (size_t i=0;i<creations_.size() && i<lambda.size();i++) {
+				if (!creations_[i]) continue;
+				FieldType x = creations_[i]->operator()(lambda[i]);
+				if (x==FieldType(0)) product.zeros++;
+				else product.nonzero *= x;
+			}
+		}
+
+		//! Updates the running product after lambda.increase() changed
+		//! one index, with one division and one multiplication
+		template<typename LambdaType>
+		void update(CreationProduct& product,const LambdaType& lambda) const
+		{
+			// now and then the product starts afresh, so rounding can't pile up
+			if (++product.steps==RESTART) {
+				start(product,lambda);
+				return;
+			}
+			size_t i = lambda.changed();
+			if (i>=creations_.size() || !creations_[i]) return;
+			FieldType x = creations_[i]->operator()(lambda.previous());
+			if (x==FieldType(0)) product.zeros--;
+			else product.nonzero /= x;
+			x = creations_[i]->operator()(lambda[i]);
+			if (x==FieldType(0)) product.zeros++;
+			else product.nonzero *= x;
+		}
+
+		//! bounds[i][lambda] bounds the amplitude of the i-th C at lambda,
+		//! the row of a bilinear for its C; rest bounds the D's
+		void bounds(std::vector<std::vector<RealType> >& bounds,
+		            RealType& rest,
+		            size_t levels) const
+		{
+			bounds.assign(creations_.size(),std::vector<RealType>(levels,0));
+			for (size_t i=0;i<creations_.size();i++) {
+				if (!creations_[i]) continue;
+				for (size_t lambda=0;lambda<levels;lambda++)
+					bounds[i][lambda] = std::abs(creations_[i]->operator()(lambda));
+			}
+			for (size_t i=0;i<bilinears_.size();i++) {
+				const BilinearSlot& b = bilinears_[i];
+				for (size_t lambda=0;lambda<levels;lambda++) {
+					RealType& x = bounds[b.creation][lambda];
+					for (size_t lambda2=0;lambda2<levels;lambda2++)
+						x = std::max(x,RealType(std::abs(b.op->operator()(lambda,
+						                                                  lambda2))));
+				}
+			}
+			rest = 1;
+			for (size_t i=0;i<destructions_.size();i++) {
+				if (!destructions_[i]) continue;
+				RealType max = 0;
+				for (size_t lambda=0;lambda<levels;lambda++)
+					max = std::max(max,
+					               RealType(std::abs(destructions_[i]->operator()(lambda))));
+				rest *= max;
+			}
+		}
+
+		//! False if no permutation of lambda can give the D's of the
+		//! bilinears with a definite transfer the momenta they need
+		template<typename LambdaType>
+		bool allowed(const LambdaType& lambda) const
+		{
+			if (momentumSlots_.size()==0) return true;
+			size_t cells = engine_->cells();
+			std::vector<size_t> available(cells,0);
+			for (size_t i=0;i<lambda.size();i++)
+				available[engine_->momentum(lambda[i])]++;
+			for (size_t i=0;i<momentumSlots_.size();i++) {
+				const MomentumSlot& m = momentumSlots_[i];
+				size_t k = engine_->momentum(lambda[m.creation]);
+				size_t needed = (k+cells-m.q) % cells;
+				if (available[needed]==0) return false;
+				available[needed]--;
+			}
+			return true;
+		}
+
+		//! False if the amplitude is zero because of momentum conservation
+		template<typename LambdaType,typename Lambda2Type>
+		bool allowed(const LambdaType& lambda,const Lambda2Type& lambda2) const
+		{
+			for (size_t i=0;i<momentumSlots_.size();i++) {
+				const MomentumSlot& m = momentumSlots_[i];
+				size_t cells = engine_->cells();
+				size_t k = engine_->momentum(lambda[m.creation]);
+				size_t k2 = engine_->momentum(lambda2[m.destruction]);
+				if ((k+cells-k2) % cells!=m.q) return false;
+			}
+			return true;
+		}
+
+	private:
+
+		// the amplitudes are columns of the engine's eigenvectors,
+		// the halves of bilinears are null here
+		std::vector<const CorDOperatorType*> creations_,destructions_;
+		std::vector<BilinearSlot> bilinears_;
+		const EngineType* engine_;
+		std::vector<MomentumSlot> momentumSlots_;
+		std::vector<size_t> creationSlots_,destructionSlots_;
+		std::vector<size_t> diagonalSlots_;
+	}; // EvaluationPlan
+} // namespace FreeFermions
+
+/*@}*/
+#endif // EVALUATION_PLAN_H
@@ -0,0 +1,203 @@
+// BEGIN LICENSE BLOCK
+/*
+Copyright (c) 2011 , UT-Battelle, LLC
+All rights reserved
+
+[FreeFermions, Version 1.0.0]
+[by G.A., Oak Ridge National Laboratory]
+
+UT Battelle Open Source Software License 11242008
+
+OPEN SOURCE LICENSE
+
+Subject to the conditions of this License, each
+contributor to this software hereby grants, free of
+charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), a
+perpetual, worldwide, non-exclusive, no-charge,
+royalty-free, irrevocable copyright license to use, copy,
+modify, merge, publish, distribute, and/or sublicense
+copies of the Software.
+
+1. Redistributions of Software must retain the above
+copyright and license notices, this list of conditions,
+and the following disclaimer.  Changes or modifications
+to, or derivative works of, the Software should be noted
+with comments and the contributor and organization's
+name.
+
+2. Neither the names of UT-Battelle, LLC or the
+Department of Energy nor the names of the Software
+contributors may be used to endorse or promote products
+derived from this software without specific prior written
+permission of UT-Battelle.
+
+3. The software and the end-user documentation included
+with the redistribution, with or without modification,
+must include the following acknowledgment:
+
+"This product includes software produced by UT-Battelle,
+LLC under Contract No. DE-AC05-00OR22725  with the
+Department of Energy."
+ 
+*********************************************************
+DISCLAIMER
+
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+COPYRIGHT OWNER, CONTRIBUTORS, UNITED STATES GOVERNMENT,
+OR THE UNITED STATES DEPARTMENT OF ENERGY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+DAMAGE.
+
+NEITHER THE UNITED STATES GOVERNMENT, NOR THE UNITED
+STATES DEPARTMENT OF ENERGY, NOR THE COPYRIGHT OWNER, NOR
+ANY OF THEIR EMPLOYEES, REPRESENTS THAT THE USE OF ANY
+INFORMATION, DATA, APPARATUS, PRODUCT, OR PROCESS
+DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
+
+*********************************************************
+
+
+*/
+// END LICENSE BLOCK
+/** \ingroup DMRG */
+/*@{*/
+
+/*! \file FermiSea.h
+ *
+ * The filled levels of one flavor taken as the vacuum,
+ * so that only particles and holes need to be tracked
+ *
+ */
+#ifndef FERMI_SEA_H
+#define FERMI_SEA_H
+
+#include "Complex.h" // in PsimagLite
+#include <vector>
+#include <algorithm>
+#include "Occupations.h"
+
+namespace FreeFermions {
+
+	template<typename EngineType>
+	class FermiSea {
+
+		typedef typename EngineType::RealType RealType;
+
+	public:
+
+		FermiSea(const EngineType& engine,
+		         const Occupations& occupations,
+		         const Occupations& occupations2)
+		: occupations_(occupations),
+		  above_(occupations.size(),0),
+		  ne_(0),
+		  ne2_(0),
+		  energy_(0)
+		{
+			if (occupations.size()!=occupations2.size())
+				throw std::runtime_error("FermiSea::ctor(...)\n");
+
+			size_t counter = 0;
+			for (int i=occupations.size()-1;i>=0;i--) {
+				above_[i] = counter;
+				if (occupations[i]==0) continue;
+				counter++;
+				energy_ += engine.eigenvalue(i);
+			}
+			ne_ = counter;
+
+			ne2_ = occupations2.count();
+			occupations.differences(differences_,occupations2);
+		}
+
+		//! Number of levels filled in the ket
+		size_t ne() const { return ne_; }
+
+		//! Number of levels filled in the bra
+		size_t ne2() const { return ne2_; }
+
+		//! Sum of the eigenvalues of the levels filled in the ket
+		const RealType& energy() const { return energy_; }
+
+		//! Applies the C's and D's in freeOps (first one first) to the ket
+		//! and returns <bra|freeOps|ket>, which is either 0, 1 or -1
+		//! Cost is quadratic in the number of operators, and independent
+		//! of the number of electrons
+		template<typename FreeOperatorsType>
+		int operator()(const FreeOperatorsType& freeOps) const
+		{
+			std::vector<size_t> excited(freeOps.size()+1);
+			return operator()(freeOps,&excited[0]);
+		}
+
+		//! Same, with room for freeOps.size() excited levels in excited
+		template<typename FreeOperatorsType>
+		int operator()(const FreeOperatorsType& freeOps,size_t* excited) const
+		{
+			size_t n = 0;
+			int sign = 1;
+			for (size_t i=0;i<freeOps.size();i++) {
+				size_t type1 = freeOps[i].type;
+				if (freeOps.notCreationOrDestruction(type1)) continue;
+				size_t lambda = freeOps[i].lambda;
+				size_t j = std::find(excited,excited+n,lambda) - excited;
+				bool occupied = (occupations_[lambda]!=0);
+				if (j<n) occupied = !occupied;
+
+				if (type1==FreeOperatorsType::CREATION && occupied) return 0;
+				if (type1==FreeOperatorsType::DESTRUCTION && !occupied)
+					return 0;
+
+				if (electronsAbove(lambda,excited,n) & 1) sign = -sign;
+
+				// the order of the excited levels doesn't matter
+				if (j==n) excited[n++] = lambda;
+				else excited[j] = excited[--n];
+			}
+
+			// bra and ket must differ exactly on the excited levels
+			if (n!=differences_.size()) return 0;
+			std::sort(excited,excited+n);
+			for (size_t i=0;i<n;i++)
+				if (excited[i]!=differences_[i]) return 0;
+			return sign;
+		}
+
+	private:
+
+		size_t electronsAbove(size_t lambda,
+		                      const size_t* excited,
+		                      size_t n) const
+		{
+			int counter = above_[lambda];
+			for (size_t i=0;i<n;i++) {
+				if (excited[i]<=lambda) continue;
+				// a particle above the sea or a hole in it
+				counter += (occupations_[excited[i]]==0) ? 1 : -1;
+			}
+			return counter;
+		}
+
+		const Occupations& occupations_;
+		std::vector<size_t> above_;
+		std::vector<size_t> differences_;
+		size_t ne_;
+		size_t ne2_;
+		RealType energy_;
+	}; // FermiSea
+} // namespace FreeFermions
+
+/*@}*/
+#endif // FERMI_SEA_H
@@ -107,10 +107,15 @@ template<typename OperatorType,typename OpPointerType>
 				value_ = 0;
 				return;
 			}
+			if (freeOps.sea()) {
+				value_ = freeOps.sea()->operator()(freeOps);
+				return;
+			}
 			freeOps.removeNonCsOrDs();
 			freeOps.reverse();
 			
 			pairUp(freeOps);
+			if (freeOps.particleHole()) value_ *= freeOps.particleHole()->sign();
 		}
 
 		RealType operator()()
@@ -143,7 +148,8 @@ template<typename OperatorType,typename OpPointerType>
 				// let's deal with the (anti)occupation first:
 
 				bool nNormal = (freeOps[0].type == CREATION) ? true : false;
-				size_t occupationForThisLamda = 0; //occupations[thisLambda];
+				// the vacuum is either empty or the filled band:
+				size_t occupationForThisLamda = (freeOps.particleHole()) ? 1 : 0;
 				if (nNormal && occupationForThisLamda==0) {
 					value_=0;
 					return;
@@ -86,6 +86,9 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 #include "Sort.h" // in PsimagLite
 #include "Permutations.h"
 #include "IndexGenerator.h"
+#include "FermiSea.h"
+#include "ParticleHole.h"
+#include "Occupations.h"
 #include <cassert>
 
 namespace FreeFermions {
@@ -108,6 +111,8 @@ namespace FreeFermions {
 		typedef IndexGenerator IndexGeneratorType;
 		typedef Permutations<IndexGeneratorType> PermutationsType;
 		typedef std::vector<OpPointerType> OpPointersType;
+		typedef FermiSea<typename OperatorType::EngineType> FermiSeaType;
+		typedef ParticleHole<typename OperatorType::EngineType> ParticleHoleType;
 
 		enum {CREATION = OperatorType::CREATION,
 		      DESTRUCTION = OperatorType::DESTRUCTION,
@@ -117,9 +122,13 @@ namespace FreeFermions {
 		              const IndexGeneratorType& lambda,
 		              const PermutationsType& lambda2,
 		              size_t sigma,
-		              const std::vector<size_t>& occupations,
-		              const std::vector<size_t>& occupations2)
-			: value_(1),loc_(0)
+		              const Occupations& occupations,
+		              const Occupations& occupations2,
+		              const RealType& vacuumEnergy,
+		              const FermiSeaType* sea = 0,
+		              const ParticleHoleType* particleHole = 0)
+			: value_(1),loc_(0),middle_(0),vacuumEnergy_(vacuumEnergy),
+			  sea_(sea),particleHole_(particleHole)
 		{
 			size_t counter3 = addAtTheFront(occupations,DRY_RUN);
 			size_t counter2=0;
@@ -134,6 +143,7 @@ namespace FreeFermions {
 			loc_=0;
 
 			addAtTheFront(occupations,NORMAL_RUN);
+			middle_ = loc_;
 			size_t counter4=0;
 			size_t counter5=0;
 			addAtTheMiddle(counter4,counter5,opPointers,lambda,lambda2,sigma,NORMAL_RUN);
@@ -146,21 +156,10 @@ namespace FreeFermions {
 			}
 		}
 
-		size_t findLocOfDiagOp(size_t ind) const
-		{
-			size_t counter = 0;
-			size_t j = 0;
-			for (size_t i=0;i<data_.size();i++) {
-				if (data_[i].type == DIAGONAL) {
-					if (counter==ind) return j;
-					counter++;
-					j++;
-				}
-				j++;
-			}
-			assert(false);
-			return 0;
-		}
+		//! Location of the first operator that isn't part of the vacuum
+		size_t middle() const { return middle_; }
+
+		void setLambda(size_t loc,size_t lambda) { data_[loc].lambda = lambda; }
 
 		void removeNonCsOrDs()
 		{
@@ -191,6 +190,17 @@ namespace FreeFermions {
 			return value_;
 		}
 
+		//! The vacuum is the Fermi sea if non-null
+		const FermiSeaType* sea() const { return sea_; }
+
+		//! The vacuum is the filled band if non-null, else the empty state
+		const ParticleHoleType* particleHole() const { return particleHole_; }
+
+		//! Energy of the levels filled in the ket, which is what
+		//! the filled levels of the vacuum and the operators in front of
+		//! middle() add up to, counting C's as +e and D's as -e
+		const RealType& vacuumEnergy() const { return vacuumEnergy_; }
+
 		void removePair(size_t thisLambda)
 		{
 			std::vector<FreeOperator>::iterator itp = data_.begin();
@@ -221,37 +231,49 @@ namespace FreeFermions {
 
 	private:
 
-		size_t addAtTheBack(const std::vector<size_t>&  occupations2,size_t typeOfRun)
+		// returns the number of electrons in the bra
+		size_t addAtTheBack(const Occupations& occupations2,size_t typeOfRun)
 		{
+			// the filled levels are the vacuum, nothing to add
+			if (sea_) return sea_->ne2();
+
+			// with the filled band as vacuum, the empty levels are refilled
+			size_t type1 = (particleHole_) ? CREATION : DESTRUCTION;
 			size_t counter = 0;
 			for (int i=occupations2.size()-1;i>=0;i--) {
-				if (occupations2[i]==0) continue;
-				counter++;
+				if (occupations2[i]!=0) counter++;
+				if ((occupations2[i]==0) == (particleHole_==0)) continue;
 				if (typeOfRun==DRY_RUN) {
 					loc_++;
 					continue;
 				}
 				FreeOperator fo;
 				fo.lambda = i;
-				fo.type = DESTRUCTION;
+				fo.type = type1;
 				data_[loc_++]=fo;
 			}
 			return counter;
 		}
 
-		 size_t addAtTheFront(const std::vector<size_t>&  occupations,size_t typeOfRun)
+		// returns the number of electrons in the ket
+		 size_t addAtTheFront(const Occupations& occupations,size_t typeOfRun)
 		 {
+			 // the filled levels are the vacuum, nothing to add
+			 if (sea_) return sea_->ne();
+
+			 // with the filled band as vacuum, the empty levels are emptied
+			 size_t type1 = (particleHole_) ? DESTRUCTION : CREATION;
 			 size_t counter = 0;
 			 for (size_t i=0;i<occupations.size();++i) {
-				 if (occupations[i]==0) continue;
-				 counter++;
+				 if (occupations[i]!=0) counter++;
+				 if ((occupations[i]==0) == (particleHole_==0)) continue;
 				 if (typeOfRun==DRY_RUN) {
 					 loc_++;
 					 continue;
 				 }
 				 FreeOperator fo;
 				 fo.lambda = i;
-				 fo.type = CREATION;
+				 fo.type = type1;
 				 data_[loc_++]=fo;
 			 }
 			 return counter;
@@ -293,7 +315,38 @@ namespace FreeFermions {
 		std::vector<FreeOperator> data_;
 		RealType value_;
 		size_t loc_;
+		size_t middle_;
+		RealType vacuumEnergy_;
+		const FermiSeaType* sea_;
+		const ParticleHoleType* particleHole_;
 	}; // FreeOperators
+
+	//! Energy of the state the operator at loc acts on, that is, of the ket
+	//! and the C's (+e) and D's (-e) in front of loc, given the energy at from
+	template<typename FreeOperatorsType,typename EngineType>
+	typename EngineType::RealType energyAt(const FreeOperatorsType& freeOps,
+	                                       size_t loc,
+	                                       const EngineType& engine,
+	                                       size_t from,
+	                                       typename EngineType::RealType energy)
+	{
+		for (size_t i=from;i<loc;i++) {
+			if (freeOps[i].type==FreeOperatorsType::CREATION)
+				energy += engine.eigenvalue(freeOps[i].lambda);
+			else if (freeOps[i].type==FreeOperatorsType::DESTRUCTION)
+				energy -= engine.eigenvalue(freeOps[i].lambda);
+		}
+		return energy;
+	}
+
+	template<typename FreeOperatorsType,typename EngineType>
+	typename EngineType::RealType energyAt(const FreeOperatorsType& freeOps,
+	                                       size_t loc,
+	                                       const EngineType& engine)
+	{
+		return energyAt(freeOps,loc,engine,freeOps.middle(),
+		                freeOps.vacuumEnergy());
+	}
 } // namespace Dmrg 
 
 /*@}*/
@@ -82,18 +82,31 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 
 #include "Complex.h" // in PsimagLite
 #include "FermionFactor.h"
+#include "EvaluationPlan.h"
+#include "BilinearOperator.h"
+#include "SharedPointer.h"
+#include "ClosedProductCache.h"
+#include "BoundedIndexGenerator.h"
+#include "Poles.h"
+#include "OperatorString.h"
+#include "MonteCarlo.h"
+#include "DryRun.h"
 #include "TypeToString.h"
+#include "Matrix.h" // in PsimagLite
+#include "Range.h" // in PsimagLite
 #include <vector>
 
 namespace FreeFermions {
 	struct OperatorPointer {
-		OperatorPointer(size_t t,size_t s,size_t i)
-		: type(t),sigma(s),index(i)
+		OperatorPointer(size_t t,size_t s,size_t i,bool b = false)
+		: type(t),sigma(s),index(i),bilinear(b)
 		{}
 
 		size_t type;
 		size_t sigma;
 		size_t index;
+		// one of the two halves of a bilinear, index is the bilinear's
+		bool bilinear;
 	};
 
 	template<typename FieldType>
@@ -101,6 +114,7 @@ namespace FreeFermions {
 	public:
 		class DummyFactory {
 		public:
+			typedef SharedPointer<const DummyOperator> HandleType;
 			template<typename X>
 			DummyFactory(const X& x) {}
 			DummyOperator& operator()(const DummyOperator* op) {
@@ -111,13 +125,42 @@ namespace FreeFermions {
 		DummyOperator(const DummyOperator* x) {}
 		template<typename T1>
 		FieldType operator()(const T1& l1,size_t loc) const { return 1; }
+		size_t size() const { return 1; }
+		template<typename T1>
+		void operator()(std::vector<FieldType>& v,const T1& l1,size_t loc) const
+		{
+			v.assign(1,1);
+		}
 		size_t sigma() const { return 0; }
+		template<typename T1>
+		T1 pole(const T1& energy) const { return energy; }
+		bool multiplicative() const { return true; }
+		template<typename T1>
+		FieldType value(const T1& pole) const { return 1; }
+		template<typename T1>
+		void values(std::vector<FieldType>& v,const T1& pole) const
+		{
+			v.assign(1,1);
+		}
 		void transpose() {}
+		template<typename KeyType>
+		void key(KeyType& key,bool transposed) const {}
+		bool windowed() const { return false; }
+		template<typename T1>
+		bool outside(const T1& pole,T1& bound) const { return false; }
 	};
 
+	// OperatorStringType_, if not AnyString, is the shape of the closed
+	// products, which are then done with arrays of its length
+	// Threads: copies may go to different threads, each pushing and
+	// closing its own; one object may be closed by several at a time once
+	// compile()d. Caches, pruning and the factories of the operators pushed
+	// by reference are one per thread; operators pushed by handle,
+	// see OperatorFactory::share(), are kept by the states
 	template<typename CorDOperatorType_,
 	          typename DiagonalOperatorType_=
-	                    DummyOperator<typename CorDOperatorType_::FieldType> >
+	                    DummyOperator<typename CorDOperatorType_::FieldType>,
+	          typename OperatorStringType_=AnyString>
 	class HilbertState {
 		typedef typename CorDOperatorType_::EngineType EngineType;
 		typedef typename CorDOperatorType_::RealType RealType;
@@ -126,78 +169,489 @@ namespace FreeFermions {
 		typedef typename FermionFactorType::FreeOperatorsType FreeOperatorsType;
 		typedef typename FreeOperatorsType::PermutationsType PermutationsType;
 		typedef typename FreeOperatorsType::IndexGeneratorType IndexGeneratorType;
-
-		typedef HilbertState<CorDOperatorType_,DiagonalOperatorType_> ThisType;
+		typedef typename FreeOperatorsType::FermiSeaType FermiSeaType;
+		typedef typename FreeOperatorsType::ParticleHoleType ParticleHoleType;
+		typedef BilinearOperator<CorDOperatorType_> BilinearOperatorType_;
+		typedef EvaluationPlan<CorDOperatorType_,
+		                       OperatorPointer,
+		                       BilinearOperatorType_> EvaluationPlanType;
+		typedef typename EvaluationPlanType::CreationProduct CreationProductType;
+		typedef HilbertState<CorDOperatorType_,
+		                     DiagonalOperatorType_,
+		                     OperatorStringType_> ThisType;
+		typedef FixedFreeOperators<CorDOperatorType_,
+		                           OperatorStringType_> FixedFreeOperatorsType;
 
 		enum {CREATION = CorDOperatorType_::CREATION,
 		       DESTRUCTION = CorDOperatorType_::DESTRUCTION,
-		       DIAGONAL
+		       DIAGONAL,
+		       BILINEAR
 		};
 
 	public:
 		typedef CorDOperatorType_ CorDOperatorType;
 		typedef DiagonalOperatorType_ DiagonalOperatorType;
+		typedef OperatorStringType_ OperatorStringType;
+		typedef BilinearOperatorType_ BilinearOperatorType;
+		// occupations[sigma][lambda] of the levels of each flavor
+		typedef std::vector<Occupations> OccupationsType;
 		typedef typename CorDOperatorType::FactoryType OpNormalFactoryType;
 		typedef typename DiagonalOperatorType::FactoryType OpDiagonalFactoryType;
+		typedef typename BilinearOperatorType::FactoryType OpBilinearFactoryType;
+		typedef ClosedProductCache<FieldType> ClosedProductCacheType;
+		typedef Poles<RealType,FieldType> PolesType;
+		typedef AmplitudePruning<RealType> AmplitudePruningType;
+		typedef MonteCarlo<RealType,FieldType> MonteCarloType;
+		typedef DryRun<RealType> DryRunType;
+
+		// With FERMI_SEA_VACUUM the occupied levels are the vacuum
+		// and only particles and holes are tracked,
+		// with EMPTY_VACUUM they're pushed as C's and D's, and paired up;
+		// above half filling EMPTY_VACUUM uses the filled band instead,
+		// and only the holes are pushed
+		enum {EMPTY_VACUUM,FERMI_SEA_VACUUM};
+
+	private:
+		// a cache holds whole products and factors of one flavor
+		enum {PRODUCT_KEY,FLAVOR_KEY};
+
+		// owns the transposed copies made by pour(), or shares the
+		// operators pushed by handle
+		struct PouredType {
+			PouredType(const EngineType& engine)
+			: opNormalFactory(engine),
+			  opDiagonalFactory(engine),
+			  opBilinearFactory(engine)
+			{}
+
+			OpNormalFactoryType opNormalFactory;
+			OpDiagonalFactoryType opDiagonalFactory;
+			OpBilinearFactoryType opBilinearFactory;
+			typename OpNormalFactoryType::HandleType opNormal;
+			typename OpDiagonalFactoryType::HandleType opDiagonal;
+			typename OpBilinearFactoryType::HandleType opBilinear;
+		};
+
+		// operators are kept in a persistent list, last one first,
+		// so that copies share it and pushes don't change the copies
+		struct OperatorNode {
+			OperatorNode(size_t t,
+			             size_t s,
+			             const CorDOperatorType* o,
+			             const DiagonalOperatorType* d,
+			             const BilinearOperatorType* b,
+			             const SharedPointer<OperatorNode>& p,
+			             const SharedPointer<PouredType>& pd)
+			: type(t),sigma(s),op(o),diagonal(d),bilinear(b),previous(p),poured(pd)
+			{}
+
+			size_t type;
+			size_t sigma;
+			const CorDOperatorType* op;
+			const DiagonalOperatorType* diagonal;
+			const BilinearOperatorType* bilinear;
+			SharedPointer<OperatorNode> previous;
+			SharedPointer<PouredType> poured;
+		};
+
+		// the list in order, and one plan per flavor, see compile()
+		struct CompiledType {
+			std::vector<const CorDOperatorType*> operatorsCreation;
+			std::vector<const CorDOperatorType*> operatorsDestruction;
+			std::vector<const DiagonalOperatorType*> operatorsDiagonal;
+			std::vector<const BilinearOperatorType*> operatorsBilinear;
+			std::vector<OperatorPointer> opPointers;
+			std::vector<EvaluationPlanType> plans;
+			// points of the parameter grids of the diagonal operators
+			size_t points;
+			// a lone diagonal operator drops poles outside its window
+			bool windowed;
+			// the diagonal operators of a product of flavors are the
+			// products of theirs, see DiagonalOperator::multiplicative()
+			bool multiplicative;
+			// the operators are the fixed string, all of this flavor
+			bool fixed;
+			size_t fixedSigma;
+			// the operators make zero of any state, see simplify()
+			bool zero;
+		};
+
+		// what the loop over lambdas writes into, see compute()
+		struct Workspace {
+			Workspace(const FreeOperatorsType& freeOps,PolesType* poles)
+			: pairs(freeOps),poles(poles)
+			{}
+
+			FreeOperatorsType pairs;
+			PolesType* poles;
+			std::vector<FieldType> diagonals;
+			std::vector<FieldType> values;
+		};
+
+		// what FreeOperators needs of the vacuum of one flavor: the sea
+		// or the particles and holes, and the energy of occupations
+		struct FlavorVacuum {
+			FlavorVacuum(const EngineType& engine,
+			             size_t vacuum,
+			             const Occupations& occupations,
+			             const Occupations& occupations2)
+			: sea(0),particleHole(0),energy(0)
+			{
+				if (vacuum==FERMI_SEA_VACUUM)
+					sea = new FermiSeaType(engine,occupations,occupations2);
+				else if (ParticleHoleType::isWorthIt(occupations,occupations2))
+					particleHole = new ParticleHoleType(engine,
+					                                    occupations,
+					                                    occupations2);
+				for (size_t i=0;i<occupations.size();i++)
+					if (occupations[i]) energy += engine.eigenvalue(i);
+			}
+
+			~FlavorVacuum()
+			{
+				delete sea;
+				delete particleHole;
+			}
+
+			FermiSeaType* sea;
+			ParticleHoleType* particleHole;
+			RealType energy;
 
+		private:
+
+			FlavorVacuum(const FlavorVacuum&);
+
+			FlavorVacuum& operator=(const FlavorVacuum&);
+		};
+
+	public:
 		// it's the g.s. for now, FIXME change it later to allow more flex.
 		HilbertState(const EngineType& engine,
 		              const std::vector<size_t>& ne,
-		              bool debug = false)
+		              bool debug = false,
+		              size_t vacuum = FERMI_SEA_VACUUM)
 		: engine_(&engine),
 		  debug_(debug),
-		  occupations_(ne.size()),
-		  opNormalFactory_(engine),
-		  opDiagonalFactory_(engine)
+		  vacuum_(vacuum),
+		  occupations_(new OccupationsType(ne.size())),
+		  cache_(0),
+		  pruning_(0)
 		{
-			   for (size_t i=0;i<occupations_.size();++i) {
-				   occupations_[i].resize(engine.size(),0);
-				   for (size_t j=0;j<ne[i];++j) {
-					   occupations_[i][j] = 1;
-				   }
-			   }
+			   OccupationsType& occupations = *occupations_;
+			   for (size_t i=0;i<occupations.size();++i)
+				   occupations[i] = Occupations(engine.size(),ne[i]);
 		}
 
 		HilbertState(const EngineType& engine,
 		             const std::vector<std::vector<size_t> >& occupations,
-		             bool debug = false)
+		             bool debug = false,
+		             size_t vacuum = FERMI_SEA_VACUUM)
+		: engine_(&engine),
+		  debug_(debug),
+		  vacuum_(vacuum),
+		  occupations_(new OccupationsType(occupations.begin(),
+		                                   occupations.end())),
+		  cache_(0),
+		  pruning_(0)
+		{
+		}
+
+		HilbertState(const EngineType& engine,
+		             const OccupationsType& occupations,
+		             bool debug = false,
+		             size_t vacuum = FERMI_SEA_VACUUM)
 		: engine_(&engine),
 		  debug_(debug),
-		  occupations_(occupations),
-		  opNormalFactory_(engine),
-		  opDiagonalFactory_(engine)
+		  vacuum_(vacuum),
+		  occupations_(new OccupationsType(occupations)),
+		  cache_(0),
+		  pruning_(0)
 		{
 		}
 
+		// copies are O(1): occupations, operators and plans are shared
+
 		void pushInto(const CorDOperatorType& op)
 		{
-			if (op.type()==CREATION) {
-				OperatorPointer opPointer(op.type(),op.sigma(),
-						operatorsCreation_.size());
-				operatorsCreation_.push_back(&op);
-				opPointers_.push_back(opPointer);
-			} else if (op.type()==DESTRUCTION) {
-				OperatorPointer opPointer(op.type(),op.sigma(),
-						operatorsDestruction_.size());
-				operatorsDestruction_.push_back(&op);
-				opPointers_.push_back(opPointer);
-			}
+			if (op.type()!=CREATION && op.type()!=DESTRUCTION) return;
+			push(op.type(),op.sigma(),&op,0,0,SharedPointer<PouredType>());
 		}
 
 		void pushInto(const DiagonalOperatorType& op)
 		{
-				OperatorPointer opPointer(DIAGONAL,0,
-						operatorsDiagonal_.size());
-				operatorsDiagonal_.push_back(&op);
-				opPointers_.push_back(opPointer);
+			push(DIAGONAL,0,0,&op,0,SharedPointer<PouredType>());
+		}
+
+		//! One C and one D, whose amplitude is one matrix element
+		void pushInto(const BilinearOperatorType& op)
+		{
+			push(BILINEAR,op.sigma(),0,0,&op,SharedPointer<PouredType>());
+		}
+
+		//! As pushInto(*handle), but the operator is kept by the state
+		//! and its copies, so it may outlive its factory
+		void pushInto(const typename OpNormalFactoryType::HandleType& handle)
+		{
+			const CorDOperatorType& op = *handle;
+			if (op.type()!=CREATION && op.type()!=DESTRUCTION) return;
+			SharedPointer<PouredType> owner(new PouredType(*engine_));
+			owner->opNormal = handle;
+			push(op.type(),op.sigma(),&op,0,0,owner);
+		}
+
+		void pushInto(const typename OpDiagonalFactoryType::HandleType& handle)
+		{
+			SharedPointer<PouredType> owner(new PouredType(*engine_));
+			owner->opDiagonal = handle;
+			push(DIAGONAL,0,0,handle.get(),0,owner);
+		}
+
+		void pushInto(const typename OpBilinearFactoryType::HandleType& handle)
+		{
+			SharedPointer<PouredType> owner(new PouredType(*engine_));
+			owner->opBilinear = handle;
+			push(BILINEAR,handle->sigma(),0,0,handle.get(),owner);
 		}
 
+		//! Closes are looked up in cache first, if any; copies share it
+		//! The cache must not outlive the engine
+		void cache(ClosedProductCacheType* cache) { cache_ = cache; }
+
+		//! Terms whose amplitudes are bound by less than the tolerance of
+		//! pruning are skipped, whole subtrees of lambdas at a time, and
+		//! their weight is added to it; copies share it, pour() passes it on
+		void pruning(AmplitudePruningType* pruning) { pruning_ = pruning; }
+
 		FieldType pourAndClose(const ThisType& hs)
 		{
 			pour(hs);
-			return close(hs.occupations_);
+			ClosedProductCacheType* cache = (cache_) ? cache_ : hs.cache_;
+			if (!cache) return close(*hs.occupations_);
+
+			// <hs|this> is the conjugate of <this|hs>, and
+			// both are stored with the smaller of their keys
+			CanonicalKey key;
+			makeKey(key,*occupations_,*hs.occupations_,false);
+			CanonicalKey conjugateKey;
+			makeKey(conjugateKey,*hs.occupations_,*occupations_,true);
+			bool conjugate = (conjugateKey<key);
+			const CanonicalKey& canonicalKey = (conjugate) ? conjugateKey : key;
+
+			// a hit leaves out what the close it stands for left out
+			FieldType value = 0;
+			double discarded = 0;
+			size_t skipped = 0;
+			if (cache->find(canonicalKey,value,discarded,skipped)) {
+				if (pruning_) pruning_->discard(discarded,skipped);
+			} else {
+				double discarded0 = 0;
+				size_t skipped0 = 0;
+				pruned(discarded0,skipped0);
+				value = close(*hs.occupations_,cache);
+				if (conjugate) value = std::conj(value);
+				pruned(discarded,skipped);
+				cache->insert(canonicalKey,value,discarded-discarded0,
+				              skipped-skipped0);
+			}
+			return (conjugate) ? std::conj(value) : value;
 		}
-		
+
+		//! For diagonal operators with a grid of parameters, values[i] is
+		//! the product for the i-th point, all in one enumeration
+		//! Operators with one point apply to all points
+		void pourAndClose(const ThisType& hs,std::vector<FieldType>& values)
+		{
+			pour(hs);
+			close(values,*hs.occupations_,(cache_) ? cache_ : hs.cache_);
+		}
+
+		//! The product is sum_k poles.residue(k) f(poles.energy(k)),
+		//! where f is the only diagonal operator, whatever its parameters,
+		//! at the pole it has for the energy; energies of flavors add
+		void pourAndClose(const ThisType& hs,PolesType& poles)
+		{
+			pour(hs);
+			if (!compiled_.get()) compile();
+			const OccupationsType& occupations2 = *hs.occupations_;
+			if (occupations_->size()!=occupations2.size() ||
+			    compiled_->operatorsDiagonal.size()!=1)
+				throw std::runtime_error("HilbertState::pourAndClose(): "
+				                         "poles need one diagonal operator\n");
+			if (vanishes(*occupations_,occupations2)) {
+				poles = PolesType(poles.tolerance());
+				return;
+			}
+
+			close(poles,*occupations_,occupations2);
+		}
+
+		//! As pourAndClose(hs,values), but each flavor's sum over lambdas
+		//! is estimated from tuples drawn as mc says, see estimate();
+		//! the streams are distributed over concurrency, and
+		//! mc has the values and their standard errors on root
+		template<typename ConcurrencyType>
+		void pourAndClose(const ThisType& hs,
+		                  MonteCarloType& mc,
+		                  ConcurrencyType& concurrency)
+		{
+			pour(hs);
+			if (!compiled_.get()) compile();
+			const OccupationsType& occupations2 = *hs.occupations_;
+			if (occupations_->size()!=occupations2.size())
+				throw std::runtime_error("HilbertState::pourAndClose()\n");
+			std::vector<FieldType> values(compiled_->points,1.0);
+			std::vector<RealType> errors(compiled_->points,0.0);
+			if (vanishes(*occupations_,occupations2)) {
+				mc.set(std::vector<FieldType>(compiled_->points,0.0),errors);
+				return;
+			}
+
+			if (occupations_->size()>1 && !compiled_->multiplicative)
+				throw std::runtime_error("HilbertState::pourAndClose(): "
+				                         "flavors of this diagonal operator "
+				                         "don't multiply\n");
+
+			// flavors are independent, so the variance of the product
+			// is |x|^2 e_y^2 + |y|^2 e_x^2 + e_x^2 e_y^2
+			std::vector<FieldType> means;
+			std::vector<RealType> flavorErrors;
+			for (size_t i=0;i<occupations_->size();i++) {
+				estimate(means,flavorErrors,i,(*occupations_)[i],occupations2[i],
+				         mc,concurrency);
+				for (size_t j=0;j<values.size();j++) {
+					RealType x = std::abs(values[j]);
+					RealType y = std::abs(means[j]);
+					RealType ex = errors[j];
+					RealType ey = flavorErrors[j];
+					errors[j] = sqrt(x*x*ey*ey + y*y*ex*ex + ex*ex*ey*ey);
+					values[j] *= means[j];
+				}
+			}
+			mc.set(values,errors);
+		}
+
+		//! What pourAndClose(hs,values) would enumerate, keep and take,
+		//! from samples tuples per flavor timed one by one, and all of
+		//! them if there are no more; as if with no pruning nor cache
+		void dryRun(const ThisType& hs,DryRunType& dry,size_t samples = 64)
+		{
+			pour(hs);
+			if (!compiled_.get()) compile();
+			const OccupationsType& occupations2 = *hs.occupations_;
+			if (occupations_->size()!=occupations2.size())
+				throw std::runtime_error("HilbertState::dryRun()\n");
+			dry = DryRunType();
+			if (vanishes(*occupations_,occupations2)) return;
+			AmplitudePruningType* pruning = pruning_;
+			pruning_ = 0;
+			for (size_t i=0;i<occupations_->size();i++)
+				dryRun(dry,i,(*occupations_)[i],occupations2[i],samples);
+			pruning_ = pruning;
+		}
+
+		//! values[c][i] = <c|ops|c> for the i-th point of the parameter
+		//! grids, for each configuration c, as for thermal or excited
+		//! ensembles; this state's own occupations aren't used
+		//! The operators are compiled once for all configurations, and
+		//! these are distributed over concurrency, values is complete on root
+		template<typename ConcurrencyType>
+		void closeEach(std::vector<std::vector<FieldType> >& values,
+		               const std::vector<OccupationsType>& configurations,
+		               ConcurrencyType& concurrency) const
+		{
+			if (!compiled_.get()) compile();
+			size_t n = configurations.size();
+			values.assign(n,std::vector<FieldType>());
+			std::vector<FieldType> sums;
+			PsimagLite::Range<ConcurrencyType> range(0,n,concurrency);
+			for (;!range.end();range.next()) {
+				size_t c = range.index();
+				const OccupationsType& occupations = configurations[c];
+				if (occupations.size()!=occupations_->size())
+					throw std::runtime_error("HilbertState::closeEach(): "
+					                         "wrong number of flavors\n");
+				values[c].assign(compiled_->points,1.0);
+				if (vanishes(occupations,occupations)) {
+					values[c].assign(compiled_->points,0.0);
+					continue;
+				}
+				if (occupations.size()>1 && !compiled_->multiplicative) {
+					closeThroughPoles(values[c],occupations,occupations);
+					continue;
+				}
+				for (size_t i=0;i<occupations.size();i++) {
+					close(sums,i,occupations[i],occupations[i]);
+					for (size_t j=0;j<sums.size();j++) values[c][j] *= sums[j];
+				}
+			}
+			concurrency.gather(values);
+		}
+
+		//! Turns the operator string into one plan per flavor, so that
+		//! several closes can reuse it; done by close() if needed, which
+		//! is not thread safe, so do it before sharing this object
+		void compile() const
+		{
+			std::vector<const OperatorNode*> nodes;
+			for (const OperatorNode* node = last_.get();
+			     node;
+			     node = node->previous.get())
+				nodes.push_back(node);
+
+			CompiledType* compiled = new CompiledType;
+			for (size_t i=nodes.size();i>0;i--) {
+				const OperatorNode& node = *nodes[i-1];
+				if (node.type==CREATION) {
+					compiled->opPointers.push_back(OperatorPointer(node.type,
+					        node.sigma,compiled->operatorsCreation.size()));
+					compiled->operatorsCreation.push_back(node.op);
+				} else if (node.type==DESTRUCTION) {
+					compiled->opPointers.push_back(OperatorPointer(node.type,
+					        node.sigma,compiled->operatorsDestruction.size()));
+					compiled->operatorsDestruction.push_back(node.op);
+				} else if (node.type==BILINEAR) {
+					size_t first = node.bilinear->first();
+					size_t second = (first==CREATION) ? DESTRUCTION : CREATION;
+					size_t index = compiled->operatorsBilinear.size();
+					compiled->opPointers.push_back(OperatorPointer(first,
+					        node.sigma,index,true));
+					compiled->opPointers.push_back(OperatorPointer(second,
+					        node.sigma,index,true));
+					compiled->operatorsBilinear.push_back(node.bilinear);
+				} else {
+					compiled->opPointers.push_back(OperatorPointer(DIAGONAL,0,
+					        compiled->operatorsDiagonal.size()));
+					compiled->operatorsDiagonal.push_back(node.diagonal);
+				}
+			}
+			simplify(*compiled);
+
+			for (size_t i=0;i<occupations_->size();i++)
+				compiled->plans.push_back(EvaluationPlanType(
+				                                  compiled->opPointers,
+				                                  compiled->operatorsCreation,
+				                                  compiled->operatorsDestruction,
+				                                  compiled->operatorsBilinear,
+				                                  i));
+			compiled->points = 1;
+			for (size_t i=0;i<compiled->operatorsDiagonal.size();i++) {
+				size_t points = compiled->operatorsDiagonal[i]->size();
+				if (points==1 || points==compiled->points) continue;
+				if (compiled->points!=1)
+					throw std::runtime_error("HilbertState::compile(): "
+					                         "grids of different sizes\n");
+				compiled->points = points;
+			}
+			compiled->windowed = (compiled->operatorsDiagonal.size()==1 &&
+			                      compiled->operatorsDiagonal[0]->windowed());
+			compiled->multiplicative = true;
+			for (size_t i=0;i<compiled->operatorsDiagonal.size();i++)
+				if (!compiled->operatorsDiagonal[i]->multiplicative())
+					compiled->multiplicative = false;
+			matchFixed(*compiled);
+			compiled_ = SharedPointer<CompiledType>(compiled);
+		}
+
 	private:
 		void pour(const ThisType& hs)
 		{
@@ -214,20 +668,170 @@ namespace FreeFermions {
 // 				throw std::runtime_error(s.c_str());
 // 			}
 
+			if (!pruning_) pruning_ = hs.pruning_;
 			pourInternal(hs);
 		}
 
-		FieldType close(const std::vector<std::vector<size_t> >& occupations2) const
+		FieldType close(const OccupationsType& occupations2,
+		                ClosedProductCacheType* cache = 0) const
+		{
+			std::vector<FieldType> values;
+			close(values,occupations2,cache);
+			if (values.size()!=1)
+				throw std::runtime_error("HilbertState::close(): "
+				                         "grids need pourAndClose(hs,values)\n");
+			return values[0];
+		}
+
+		//! One factor per flavor, each from its own operators only;
+		//! flavors with the same operators and occupations share it,
+		//! and with a cache, factors are shared across closes too
+		void close(std::vector<FieldType>& values,
+		           const OccupationsType& occupations2,
+		           ClosedProductCacheType* cache = 0) const
 		{
 			//std::cerr<<"DEBUG: closing with weight="<<opPointers_.size()<<"\n";
-			FieldType prod = 1.0;
-			if (occupations_.size()!=occupations2.size())
+			if (occupations_->size()!=occupations2.size())
 				throw std::runtime_error("HilbertState::close()\n");
+			if (!compiled_.get()) compile();
+
+			size_t flavors = occupations_->size();
+			// the cache holds one value per key, not grids
+			if (compiled_->points!=1) cache = 0;
+			std::vector<CanonicalKey> keys(flavors);
+			std::vector<std::vector<FieldType> > factors(flavors);
+			values.assign(compiled_->points,1.0);
+			if (vanishes(*occupations_,occupations2)) {
+				values.assign(compiled_->points,0.0);
+				return;
+			}
+			if (flavors>1 && !compiled_->multiplicative) {
+				closeThroughPoles(values,*occupations_,occupations2);
+				return;
+			}
+			// a shared factor leaves out what it left out where it was made
+			std::vector<double> discarded(flavors,0);
+			std::vector<size_t> skipped(flavors,0);
+			for (size_t i=0;i<flavors;i++) {
+				makeFlavorKey(keys[i],i,occupations2[i]);
+				size_t same = 0;
+				while (same<i && !(keys[same]==keys[i])) same++;
+				FieldType value = 0;
+				if (same<i) {
+					factors[i] = factors[same];
+					discarded[i] = discarded[same];
+					skipped[i] = skipped[same];
+					if (pruning_) pruning_->discard(discarded[i],skipped[i]);
+				} else if (cache &&
+				           cache->find(keys[i],value,discarded[i],skipped[i])) {
+					factors[i].assign(1,value);
+					if (pruning_) pruning_->discard(discarded[i],skipped[i]);
+				} else {
+					double discarded0 = 0;
+					size_t skipped0 = 0;
+					pruned(discarded0,skipped0);
+					close(factors[i],i,(*occupations_)[i],occupations2[i]);
+					pruned(discarded[i],skipped[i]);
+					discarded[i] -= discarded0;
+					skipped[i] -= skipped0;
+					if (cache) cache->insert(keys[i],factors[i][0],
+					                         discarded[i],skipped[i]);
+				}
+				for (size_t j=0;j<values.size();j++) values[j] *= factors[i][j];
+			}
+			// FIXME: NEEDS FERMION SIGN
+		}
+
+		// what pruning_ has left out so far, so that a close can tell
+		// its own share by the difference
+		void pruned(double& discarded,size_t& skipped) const
+		{
+			discarded = (pruning_) ? pruning_->discarded() : 0;
+			skipped = (pruning_) ? pruning_->skipped() : 0;
+		}
 
-			for (size_t i=0;i<occupations_.size();i++) {
-				prod *= close(i,occupations2[i]);
+		//! The poles of each flavor, convolved, as their energies add
+		void close(PolesType& poles,
+		           const OccupationsType& occupations,
+		           const OccupationsType& occupations2) const
+		{
+			std::vector<FieldType> sums;
+			for (size_t i=0;i<occupations.size();i++) {
+				PolesType flavorPoles(poles.tolerance());
+				close(sums,i,occupations[i],occupations2[i],&flavorPoles);
+				if (i==0) poles = flavorPoles;
+				else poles.convolve(flavorPoles);
+			}
+		}
+
+		//! For a diagonal operator that doesn't multiply on flavors,
+		//! as 1/(z-H), the values are taken at the total energies,
+		//! and its window, if any, applies to these
+		void closeThroughPoles(std::vector<FieldType>& values,
+		                       const OccupationsType& occupations,
+		                       const OccupationsType& occupations2) const
+		{
+			if (compiled_->operatorsDiagonal.size()!=1)
+				throw std::runtime_error("HilbertState::close(): a diagonal "
+				                         "operator that doesn't multiply on "
+				                         "flavors must be the only one\n");
+			const DiagonalOperatorType& op = *compiled_->operatorsDiagonal[0];
+			PolesType poles;
+			close(poles,occupations,occupations2);
+			values.assign(compiled_->points,0.0);
+			std::vector<FieldType> tmp;
+			for (size_t k=0;k<poles.size();k++) {
+				RealType pole = op.pole(poles.energy(k));
+				RealType bound = 0;
+				if (op.outside(pole,bound)) {
+					if (pruning_) pruning_->discard(std::abs(poles.residue(k))*bound,1);
+					continue;
+				}
+				op.values(tmp,pole);
+				for (size_t j=0;j<values.size();j++)
+					values[j] += poles.residue(k)*tmp[j];
+			}
+		}
+
+		// what the factor of flavor sigma depends on: its own operators,
+		// the diagonal ones in between, and its occupations, but not sigma
+		void makeFlavorKey(CanonicalKey& key,
+		                   size_t sigma,
+		                   const Occupations& occupations2) const
+		{
+			size_t kind = FLAVOR_KEY;
+			key.append(kind);
+			key.append(engine_);
+			key.append(tolerance());
+			key.append(vacuum_);
+			key.append((*occupations_)[sigma]);
+			key.append(occupations2);
+
+			const CompiledType& compiled = *compiled_;
+			const std::vector<OperatorPointer>& opPointers = compiled.opPointers;
+			for (size_t i=0;i<opPointers.size();i++) {
+				const OperatorPointer& opPointer = opPointers[i];
+				size_t type1 = opPointer.type;
+				if (type1==DIAGONAL) {
+					key.append(type1);
+					compiled.operatorsDiagonal[opPointer.index]->key(key,false);
+					continue;
+				}
+				if (opPointer.sigma!=sigma) continue;
+				if (opPointer.bilinear) {
+					// both halves point to it, once is enough
+					type1 = BILINEAR;
+					key.append(type1);
+					compiled.operatorsBilinear[opPointer.index]->key(key,false);
+					i++;
+					continue;
+				}
+				key.append(type1);
+				const CorDOperatorType* op = (type1==CREATION) ?
+				                compiled.operatorsCreation[opPointer.index] :
+				                compiled.operatorsDestruction[opPointer.index];
+				key.append(op->index());
 			}
-			return prod; // FIXME: NEEDS FERMION SIGN
 		}
 
 		bool equalZero(const std::vector<std::vector<size_t> >& v) const
@@ -243,140 +847,710 @@ namespace FreeFermions {
 			return true;
 		}
 
-		FieldType close(size_t sigma,const std::vector<size_t>& occupations2) const
+		void close(std::vector<FieldType>& sums,
+		           size_t sigma,
+		           const Occupations& occupations,
+		           const Occupations& occupations2,
+		           PolesType* poles = 0) const
 		{
-			size_t m = findCreationGivenSpin(sigma);
-			IndexGeneratorType lambda(m,engine_->size());
-			FieldType sum  = 0;
+			const CompiledType& compiled = *compiled_;
+			const EvaluationPlanType& plan = compiled.plans[sigma];
+			IndexGeneratorType lambda(plan.creations(),engine_->size());
+			FlavorVacuum vacuum(*engine_,vacuum_,occupations,occupations2);
+			// the plan fills in the lambdas later
+			PermutationsType lambda2(lambda);
+			FreeOperatorsType freeOps(compiled.opPointers,lambda,lambda2,sigma,
+			                          occupations,occupations2,vacuum.energy,
+			                          vacuum.sea,vacuum.particleHole);
+			sums.assign(compiled.points,0.0);
+			// zero if the number of C's and D's don't match
+			if (freeOps()!=0) {
+				Workspace workspace(freeOps,poles);
+				if (tolerance()>0) {
+					std::vector<std::vector<RealType> > bounds;
+					RealType rest = 1;
+					plan.bounds(bounds,rest,engine_->size());
+					BoundedIndexGenerator<RealType> bounded(bounds,rest,*pruning_);
+					if (bounded.valid()) do {
+						compute(sums,bounded,plan.creationAmplitude(bounded),
+						        compiled,plan,freeOps,workspace);
+					} while (bounded.increase());
+				} else if (vacuum.sea && !poles && !compiled.windowed &&
+				           compiled.fixed && compiled.fixedSigma==sigma) {
+					closeFixed(sums,lambda,compiled,plan,*vacuum.sea,vacuum.energy,
+					           static_cast<const OperatorStringType*>(0));
+				} else {
+					// lambda changes one index at a time, and so does
+					// the product of the amplitudes of the C's
+					CreationProductType creations;
+					plan.start(creations,lambda);
+					while (true) {
+						compute(sums,lambda,creations(),compiled,plan,freeOps,workspace);
+						if (!lambda.increase()) break;
+						plan.update(creations,lambda);
+					}
+				}
+			}
+		}
+
+		// the sum over lambdas of flavor sigma as the mean of sum(lambda)/p,
+		// the terms of a tuple drawn with probability p proportional to its
+		// bound on the C amplitudes, so that it's exact if only the C's
+		// vary; terms below the pruning tolerance or outside a window
+		// are still dropped. Each flavor has its own streams
+		template<typename ConcurrencyType>
+		void estimate(std::vector<FieldType>& means,
+		              std::vector<RealType>& errors,
+		              size_t sigma,
+		              const Occupations& occupations,
+		              const Occupations& occupations2,
+		              const MonteCarloType& mc,
+		              ConcurrencyType& concurrency) const
+		{
+			const CompiledType& compiled = *compiled_;
+			const EvaluationPlanType& plan = compiled.plans[sigma];
+			size_t points = compiled.points;
+			errors.assign(points,0.0);
+			size_t n = mc.samples()*mc.streams();
+			if (plan.creations()==0 || n<2) {
+				close(means,sigma,occupations,occupations2);
+				return;
+			}
+			means.assign(points,0.0);
+			std::vector<std::vector<RealType> > bounds;
+			RealType rest = 1;
+			plan.bounds(bounds,rest,engine_->size());
+			LambdaSampler<RealType> sampler(bounds);
+			if (!sampler.valid()) return;
+
+			IndexGeneratorType lambda(plan.creations(),engine_->size());
+			FlavorVacuum vacuum(*engine_,vacuum_,occupations,occupations2);
+			PermutationsType lambda2(lambda);
+			FreeOperatorsType freeOps(compiled.opPointers,lambda,lambda2,sigma,
+			                          occupations,occupations2,vacuum.energy,
+			                          vacuum.sea,vacuum.particleHole);
+			if (freeOps()==0) return;
+
+			// moments[s] has the sums of x and of |x|^2 of stream s
+			std::vector<std::vector<FieldType> > moments(mc.streams());
+			Workspace workspace(freeOps,0);
+			std::vector<FieldType> sums;
+			PsimagLite::Range<ConcurrencyType> range(0,mc.streams(),concurrency);
+			for (;!range.end();range.next()) {
+				size_t s = range.index();
+				RandomStream random(mc.seed(),sigma*mc.streams() + s);
+				moments[s].assign(2*points,0.0);
+				for (size_t k=0;k<mc.samples();k++) {
+					RealType p = sampler.draw(random);
+					sums.assign(points,0.0);
+					compute(sums,sampler,plan.creationAmplitude(sampler),
+					        compiled,plan,freeOps,workspace);
+					for (size_t j=0;j<points;j++) {
+						FieldType x = sums[j]/p;
+						RealType a = std::abs(x);
+						moments[s][j] += x;
+						moments[s][points+j] += a*a;
+					}
+				}
+			}
+			concurrency.gather(moments);
+			if (!concurrency.root()) return;
+
+			for (size_t j=0;j<points;j++) {
+				FieldType sum = 0;
+				RealType second = 0;
+				for (size_t s=0;s<moments.size();s++) {
+					sum += moments[s][j];
+					second += std::real(moments[s][points+j]);
+				}
+				means[j] = sum/RealType(n);
+				RealType a = std::abs(means[j]);
+				RealType variance = (second/RealType(n) - a*a)*n/RealType(n-1);
+				errors[j] = (variance>0) ? sqrt(variance/n) : 0;
+			}
+		}
+
+		// the tuples of flavor sigma are levels^c, their permutations and
+		// terms are counted and their compute() timed on a uniform sample
+		void dryRun(DryRunType& dry,
+		            size_t sigma,
+		            const Occupations& occupations,
+		            const Occupations& occupations2,
+		            size_t samples) const
+		{
+			const CompiledType& compiled = *compiled_;
+			const EvaluationPlanType& plan = compiled.plans[sigma];
+			size_t levels = engine_->size();
+			IndexGeneratorType lambda(plan.creations(),levels);
+			FlavorVacuum vacuum(*engine_,vacuum_,occupations,occupations2);
+			PermutationsType lambda2(lambda);
+			FreeOperatorsType freeOps(compiled.opPointers,lambda,lambda2,sigma,
+			                          occupations,occupations2,vacuum.energy,
+			                          vacuum.sea,vacuum.particleHole);
+			// the operators, their copy for the sign and the grids
+			RealType bytes = 2*freeOps.size()*sizeof(FreeOperator) +
+			                 3*compiled.points*sizeof(FieldType);
+			if (freeOps()==0) {
+				dry.add(0,0,0,bytes,0);
+				return;
+			}
+
+			RealType tuples = pow(RealType(levels),RealType(plan.creations()));
+			Workspace workspace(freeOps,0);
+			std::vector<FieldType> sums;
+			RealType permutations = 0;
+			RealType terms = 0;
+			RealType seconds = 0;
+			if (tuples<=samples) {
+				while (true) {
+					seconds += time(sums,lambda,compiled,plan,freeOps,workspace);
+					count(permutations,terms,lambda,plan,freeOps,workspace);
+					if (!lambda.increase()) break;
+				}
+				dry.add(tuples,permutations,terms,bytes,seconds);
+				return;
+			}
+
+			std::vector<std::vector<RealType> > uniform(plan.creations(),
+			                          std::vector<RealType>(levels,1.0));
+			LambdaSampler<RealType> sampler(uniform);
+			RandomStream random(1,sigma);
+			for (size_t k=0;k<samples;k++) {
+				sampler.draw(random);
+				seconds += time(sums,sampler,compiled,plan,freeOps,workspace);
+				count(permutations,terms,sampler,plan,freeOps,workspace);
+			}
+			RealType scale = tuples/samples;
+			dry.add(tuples,permutations*scale,terms*scale,bytes,seconds*scale);
+		}
+
+		template<typename LambdaType>
+		RealType time(std::vector<FieldType>& sums,
+		              const LambdaType& lambda,
+		              const CompiledType& compiled,
+		              const EvaluationPlanType& plan,
+		              FreeOperatorsType& lambdaOperators,
+		              Workspace& workspace) const
+		{
+			sums.assign(compiled.points,0.0);
+			RealType start = DryRunType::now();
+			compute(sums,lambda,plan.creationAmplitude(lambda),
+			        compiled,plan,lambdaOperators,workspace);
+			return DryRunType::now() - start;
+		}
+
+		// as compute(), without the amplitudes and diagonal operators
+		template<typename LambdaType>
+		void count(RealType& permutations,
+		           RealType& terms,
+		           const LambdaType& lambda,
+		           const EvaluationPlanType& plan,
+		           FreeOperatorsType& lambdaOperators,
+		           Workspace& workspace) const
+		{
+			if (!plan.allowed(lambda)) return;
+			Permutations<LambdaType> lambda2(lambda);
 			do {
-				sum += compute(lambda,sigma,occupations2);
-			} while (lambda.increase());
-			return sum;
+				permutations++;
+				if (!plan.allowed(lambda,lambda2)) continue;
+				plan.fill(lambdaOperators,lambda,lambda2);
+				workspace.pairs = lambdaOperators;
+				FermionFactorType fermionFactor(workspace.pairs);
+				if (fabs(fermionFactor())<1e-6) continue;
+				if (plan.amplitude(lambda,lambda2)==FieldType(0)) continue;
+				terms++;
+			} while (lambda2.increase());
 		}
 
-		size_t findCreationGivenSpin(size_t sigma) const
+		// c_i c_i and c^\dagger_i c^\dagger_i in a row are zero, and
+		// c^\dagger_i c_i c^\dagger_i c_i, n_i twice, is n_i, as is
+		// (c_i c^\dagger_i)^2 = c_i c^\dagger_i, one lambda less to enumerate
+		void simplify(CompiledType& compiled) const
 		{
-			size_t counter = 0;
-			for (size_t i=0;i<opPointers_.size();i++) {
-				if (opPointers_[i].type == CREATION &&
-				    opPointers_[i].sigma == sigma) counter++;
+			compiled.zero = false;
+			std::vector<OperatorPointer>& ops = compiled.opPointers;
+			size_t i = 0;
+			while (i+1<ops.size()) {
+				if (sameSite(compiled,ops[i],ops[i+1]) && ops[i].type==ops[i+1].type) {
+					compiled.zero = true;
+					return;
+				}
+				if (i+3<ops.size() &&
+				    sameSite(compiled,ops[i],ops[i+1]) &&
+				    sameSite(compiled,ops[i],ops[i+2]) &&
+				    sameSite(compiled,ops[i],ops[i+3]) &&
+				    ops[i].type==ops[i+2].type &&
+				    ops[i+1].type==ops[i+3].type) {
+					ops.erase(ops.begin()+i+2,ops.begin()+i+4);
+					continue;
+				}
+				i++;
 			}
-			return counter;
 		}
 
-		FieldType compute(const IndexGeneratorType& lambda,
-		                  size_t sigma,
-		                  const std::vector<size_t>& occupations2) const
+		// C's or D's of the same site and flavor, not halves of bilinears
+		bool sameSite(const CompiledType& compiled,
+		              const OperatorPointer& op1,
+		              const OperatorPointer& op2) const
 		{
+			if (op1.bilinear || op2.bilinear || op1.sigma!=op2.sigma) return false;
+			if (op1.type!=CREATION && op1.type!=DESTRUCTION) return false;
+			if (op2.type!=CREATION && op2.type!=DESTRUCTION) return false;
+			return (site(compiled,op1)==site(compiled,op2));
+		}
 
-			PermutationsType lambda2(lambda);
-			FieldType sum = 0;
+		size_t site(const CompiledType& compiled,const OperatorPointer& op) const
+		{
+			return (op.type==CREATION) ?
+			        compiled.operatorsCreation[op.index]->index() :
+			        compiled.operatorsDestruction[op.index]->index();
+		}
+
+		// zero with no enumeration: simplify() said so, or a flavor gets a C
+		// when full or a D when empty, or ends with other than the bra's
+		// number of electrons
+		bool vanishes(const OccupationsType& occupations,
+		              const OccupationsType& occupations2) const
+		{
+			const CompiledType& compiled = *compiled_;
+			if (compiled.zero) return true;
+			const std::vector<OperatorPointer>& ops = compiled.opPointers;
+			for (size_t sigma=0;sigma<occupations.size();sigma++) {
+				int n = occupations[sigma].count();
+				int levels = occupations[sigma].size();
+				for (size_t i=0;i<ops.size();i++) {
+					if (ops[i].type!=CREATION && ops[i].type!=DESTRUCTION) continue;
+					if (ops[i].sigma!=sigma) continue;
+					n += (ops[i].type==CREATION) ? 1 : -1;
+					if (n<0 || n>levels) return true;
+				}
+				if (n!=int(occupations2[sigma].count())) return true;
+			}
+			return false;
+		}
+
+		// products of AnyString are never fixed
+		void closeFixed(std::vector<FieldType>&,
+		                IndexGeneratorType&,
+		                const CompiledType&,
+		                const EvaluationPlanType&,
+		                const FermiSeaType&,
+		                const RealType&,
+		                const AnyString*) const
+		{}
+
+		// as compute(), but the operators are an array of the string's
+		// length, signed by the sea without a copy and without the heap
+		template<typename StringType>
+		void closeFixed(std::vector<FieldType>& sums,
+		                IndexGeneratorType& lambda,
+		                const CompiledType& compiled,
+		                const EvaluationPlanType& plan,
+		                const FermiSeaType& sea,
+		                const RealType& vacuumEnergy,
+		                const StringType*) const
+		{
+			enum {LENGTH = StringType::LENGTH};
+			FixedFreeOperatorsType ops;
+			size_t excited[LENGTH];
+			std::vector<FieldType> dd;
+			std::vector<FieldType> values;
+			CreationProductType creations;
+			plan.start(creations,lambda);
+			while (true) {
+				if (plan.allowed(lambda) && creations()!=FieldType(0)) {
+					Permutations<IndexGeneratorType> lambda2(lambda);
+					do {
+						if (!plan.allowed(lambda,lambda2)) continue;
+						ops.fill(lambda,lambda2);
+						int ff = sea(ops,excited);
+						if (ff==0) continue;
+						FieldType prod = creations()*
+						                 plan.destructionAmplitude(lambda,lambda2);
+						if (ff<0) prod = -prod;
+
+						dd.assign(compiled.points,1.0);
+						RealType energy = vacuumEnergy;
+						size_t diagonal = 0;
+						for (size_t i=0;i<LENGTH;i++) {
+							if (ops[i].type==CREATION) {
+								energy += engine_->eigenvalue(ops[i].lambda);
+								continue;
+							}
+							if (ops[i].type==DESTRUCTION) {
+								energy -= engine_->eigenvalue(ops[i].lambda);
+								continue;
+							}
+							const DiagonalOperatorType& op =
+							                 *compiled.operatorsDiagonal[diagonal++];
+							op.values(values,op.pole(energy));
+							if (values.size()==1) {
+								for (size_t j=0;j<dd.size();j++) dd[j] *= values[0];
+								continue;
+							}
+							for (size_t j=0;j<dd.size();j++) dd[j] *= values[j];
+						}
+						for (size_t j=0;j<sums.size();j++) sums[j] += prod*dd[j];
+					} while (lambda2.increase());
+				}
+				if (!lambda.increase()) break;
+				plan.update(creations,lambda);
+			}
+		}
+
+		// the operators are the fixed string if their types match it, and
+		// its C's and D's are of one flavor; else the runtime path is taken
+		void matchFixed(CompiledType& compiled) const
+		{
+			compiled.fixed = false;
+			compiled.fixedSigma = 0;
+			const std::vector<OperatorPointer>& ops = compiled.opPointers;
+			if (!OperatorStringType::FIXED || ops.size()!=OperatorStringType::LENGTH)
+				return;
+			std::vector<size_t> types(ops.size()+1);
+			OperatorStringType::types(&types[0]);
+			bool first = true;
+			for (size_t i=0;i<ops.size();i++) {
+				if (ops[i].type!=types[i] || ops[i].bilinear) return;
+				if (ops[i].type==DIAGONAL) continue;
+				if (!first && ops[i].sigma!=compiled.fixedSigma) return;
+				compiled.fixedSigma = ops[i].sigma;
+				first = false;
+			}
+			compiled.fixed = !first;
+		}
+
+		template<typename LambdaType>
+		void compute(std::vector<FieldType>& sums,
+		             const LambdaType& lambda,
+		             const FieldType& creations,
+		             const CompiledType& compiled,
+		             const EvaluationPlanType& plan,
+		             FreeOperatorsType& lambdaOperators,
+		             Workspace& workspace) const
+		{
+
+			// tuples that break momentum conservation have no terms,
+			// nor do those with a C of zero amplitude
+			if (!plan.allowed(lambda) || creations==FieldType(0)) return;
+
+			Permutations<LambdaType> lambda2(lambda);
+			std::vector<FieldType>& dd = workspace.diagonals;
+			RealType tolerance = this->tolerance();
 			do  {
-				FieldType prod = 1;
-				FreeOperatorsType lambdaOperators(opPointers_,lambda,lambda2,
-				                   sigma,occupations_[sigma],occupations2);
-				// diag. part need to be done here, because...
-				FieldType dd = 1.0;
-				for (size_t i=0;i<operatorsDiagonal_.size();i++) {
-					size_t loc = lambdaOperators.findLocOfDiagOp(i);
-					dd *= operatorsDiagonal_[i]->operator()(lambdaOperators,loc);
+				if (!plan.allowed(lambda,lambda2)) continue;
+
+				// when pruning, small terms are skipped before any sign work
+				FieldType amplitude = 0;
+				if (tolerance>0) {
+					amplitude = creations*plan.destructionAmplitude(lambda,lambda2);
+					if (std::abs(amplitude)<tolerance) {
+						pruning_->discard(std::abs(amplitude),1);
+						continue;
+					}
 				}
-				// ... fermionFactor ctor will modify lambdaOperators
 
-				FermionFactorType fermionFactor(lambdaOperators);
-				RealType ff = fermionFactor();
+				// and so are terms with a pole outside the window, with,
+				// as |ff|<=1, at most |amplitude|*bound left out
+				if (compiled.windowed && !workspace.poles) {
+					const DiagonalOperatorType& op = *compiled.operatorsDiagonal[0];
+					RealType energy = plan.diagonalEnergy(lambdaOperators,lambda,
+					                                      lambda2,0,*engine_);
+					RealType bound = 0;
+					if (op.outside(op.pole(energy),bound)) {
+						if (!pruning_) continue;
+						if (tolerance==0)
+							amplitude = creations*plan.destructionAmplitude(lambda,
+							                                                lambda2);
+						pruning_->discard(std::abs(amplitude)*bound,1);
+						continue;
+					}
+				}
 
+				// only the lambdas change from one term to the next
+				plan.fill(lambdaOperators,lambda,lambda2);
+
+				// fermionFactor ctor will modify its operators, so
+				// it gets a copy, and the diag. part is done afterwards
+				// only if needed
+				workspace.pairs = lambdaOperators;
+				FermionFactorType fermionFactor(workspace.pairs);
+				RealType ff = fermionFactor();
 				if (fabs(ff)<1e-6) continue;
-				for (size_t i=0;i<lambda.size();i++) {
-					int loc = findLocOf(operatorsCreation_,i,sigma);
-					if (loc<0) continue;
-					prod *= operatorsCreation_[loc]->operator()(lambda[i]);
+				if (tolerance==0)
+					amplitude = creations*plan.destructionAmplitude(lambda,lambda2);
+
+				if (workspace.poles) {
+					size_t loc = plan.diagonalLocation(lambdaOperators,0);
+					RealType energy = energyAt(lambdaOperators,loc,*engine_);
+					workspace.poles->add(energy,amplitude*ff);
+					continue;
 				}
-				for (size_t i=0;i<lambda2.size();i++) {
-					int loc = findLocOf(operatorsDestruction_,i,sigma);
-					if (loc<0) continue;
-					prod *= operatorsDestruction_[loc]->operator()(lambda2[i]);
+
+				// the diagonal operators come in the order of their
+				// locations, so one running sum gives all their energies
+				dd.assign(compiled.points,1.0);
+				size_t from = lambdaOperators.middle();
+				RealType energy = lambdaOperators.vacuumEnergy();
+				for (size_t i=0;i<compiled.operatorsDiagonal.size();i++) {
+					size_t loc = plan.diagonalLocation(lambdaOperators,i);
+					energy = energyAt(lambdaOperators,loc,*engine_,from,energy);
+					from = loc;
+					const DiagonalOperatorType& op = *compiled.operatorsDiagonal[i];
+					RealType pole = op.pole(energy);
+					if (op.size()==1) {
+						FieldType x = op.value(pole);
+						for (size_t j=0;j<dd.size();j++) dd[j] *= x;
+						continue;
+					}
+					op.values(workspace.values,pole);
+					for (size_t j=0;j<dd.size();j++) dd[j] *= workspace.values[j];
 				}
+
+				FieldType prod = amplitude*ff;
 				if (debug_) {
 					std::cerr<<" lambda="<<lambda;
 					std::cerr<<" lambda2="<<lambda2;
-					std::cerr<<" ff="<<ff<<" dd="<<dd<<" prod="<<prod;
-					std::cerr<<"sum ="<<sum<<"\n";
+					std::cerr<<" ff="<<ff<<" dd="<<dd[0]<<" prod="<<prod;
+					std::cerr<<"sum ="<<sums[0]<<"\n";
 				}
-				sum += prod*ff*dd;
+				for (size_t j=0;j<sums.size();j++) sums[j] += prod*dd[j];
 
 			} while(lambda2.increase());
-			return sum;
 		}
 
-		int findLocOf(
-		                  const std::vector<const CorDOperatorType*>& v,
-		                  size_t ind,
-		                  size_t sigma) const
+		RealType tolerance() const
 		{
-			size_t counter = 0;
-			for (size_t i=0;i<v.size();i++) {
-				if (v[i]->sigma() != sigma) continue;
-				if (counter==ind) return i;
-				counter++;
+			return (pruning_) ? pruning_->tolerance() : 0;
+		}
+
+		// <bra|ops|ket> if hermitian is false, else <ket|ops^\dagger|bra>
+		void makeKey(CanonicalKey& key,
+		             const OccupationsType& ket,
+		             const OccupationsType& bra,
+		             bool hermitian) const
+		{
+			size_t kind = PRODUCT_KEY;
+			key.append(kind);
+			key.append(engine_);
+			key.append(tolerance());
+			for (size_t i=0;i<ket.size();i++) {
+				key.append(ket[i]);
+				key.append(bra[i]);
+			}
+
+			std::vector<const OperatorNode*> nodes;
+			for (const OperatorNode* node = last_.get();
+			     node;
+			     node = node->previous.get())
+				nodes.push_back(node);
+
+			// the list is last one first, the dagger reverses it
+			size_t n = nodes.size();
+			for (size_t i=0;i<n;i++) {
+				const OperatorNode& node = *nodes[(hermitian) ? i : n-1-i];
+				size_t type1 = node.type;
+				if (type1==DIAGONAL) {
+					key.append(type1);
+					node.diagonal->key(key,hermitian);
+					continue;
+				}
+				if (type1==BILINEAR) {
+					key.append(type1);
+					node.bilinear->key(key,hermitian);
+					key.append(node.sigma);
+					continue;
+				}
+				if (hermitian) type1 = (type1==CREATION) ? DESTRUCTION : CREATION;
+				key.append(type1);
+				key.append(node.op->index());
+				key.append(node.op->sigma());
 			}
-			return -1;
+		}
+
+		void push(size_t type,
+		          size_t sigma,
+		          const CorDOperatorType* op,
+		          const DiagonalOperatorType* diagonal,
+		          const BilinearOperatorType* bilinear,
+		          const SharedPointer<PouredType>& poured)
+		{
+			last_ = SharedPointer<OperatorNode>(
+			        new OperatorNode(type,sigma,op,diagonal,bilinear,last_,poured));
+			compiled_ = SharedPointer<CompiledType>();
 		}
 
 		void pourInternal(const ThisType& hs)
 		{
-			size_t counter = 0;
-			size_t counter2 = 0;
-			size_t counter3 = 0;
-			size_t n1 = hs.opPointers_.size();
-			// pour them in reverse order:
-			for (size_t i=0;i<hs.opPointers_.size();i++) {
-				if (hs.opPointers_[n1-i-1].type==CREATION) {
-					size_t x1 = hs.operatorsCreation_.size() - 1 - counter;
-					const CorDOperatorType* op = hs.operatorsCreation_[x1];
-					counter++;
-					CorDOperatorType& opCopy = opNormalFactory_(op);
-					opCopy.transpose();
-					pushInto(opCopy);
-				} else if (hs.opPointers_[n1-i-1].type==DESTRUCTION) {
-					size_t x2 = hs.operatorsDestruction_.size() - 1 - counter2;
-					const CorDOperatorType* op = hs.operatorsDestruction_[x2];
-					counter2++;
-					CorDOperatorType& opCopy = opNormalFactory_(op);
+			SharedPointer<PouredType> poured(new PouredType(*engine_));
+			// pour them in reverse order, ie, last one first:
+			for (const OperatorNode* node = hs.last_.get();
+			     node;
+			     node = node->previous.get()) {
+				if (node->type==DIAGONAL) {
+					DiagonalOperatorType& opCopy =
+					             poured->opDiagonalFactory(node->diagonal);
 					opCopy.transpose();
-					pushInto(opCopy);
-				} else {
-					size_t x3 = hs.operatorsDiagonal_.size() - 1 - counter3;
-					const DiagonalOperatorType* op = hs.operatorsDiagonal_[x3];
-					counter3++;
-					DiagonalOperatorType& opCopy = opDiagonalFactory_(op);
+					push(DIAGONAL,0,0,&opCopy,0,poured);
+					continue;
+				}
+				if (node->type==BILINEAR) {
+					BilinearOperatorType& opCopy =
+					             poured->opBilinearFactory(node->bilinear);
 					opCopy.transpose();
-					pushInto(opCopy);
+					push(BILINEAR,opCopy.sigma(),0,0,&opCopy,poured);
+					continue;
 				}
+				CorDOperatorType& opCopy = poured->opNormalFactory(node->op);
+				opCopy.transpose();
+				push(opCopy.type(),opCopy.sigma(),&opCopy,0,0,poured);
 			}
 		}
 
 		const EngineType* engine_;
 		bool debug_;
-		std::vector<std::vector<size_t> > occupations_;
-// 		std::vector<size_t> ne_;
-// 		std::vector<size_t> ne2_;
-		std::vector<const CorDOperatorType*> operatorsCreation_,operatorsDestruction_;
-		std::vector<const DiagonalOperatorType*> operatorsDiagonal_;
-		std::vector<OperatorPointer> opPointers_;
-		OpNormalFactoryType opNormalFactory_;
-		OpDiagonalFactoryType opDiagonalFactory_;
+		size_t vacuum_;
+		SharedPointer<OccupationsType> occupations_;
+		SharedPointer<OperatorNode> last_;
+		mutable SharedPointer<CompiledType> compiled_;
+		ClosedProductCacheType* cache_;
+		AmplitudePruningType* pruning_;
 	}; // HilbertState
 	
-	template<typename CorDOperatorType,typename DiagonalOperatorType>
+	template<typename CorDOperatorType,
+	         typename DiagonalOperatorType,
+	         typename OperatorStringType>
 	typename CorDOperatorType::FieldType scalarProduct(
-	      const HilbertState<CorDOperatorType,DiagonalOperatorType>& s1,
-	      const HilbertState<CorDOperatorType,DiagonalOperatorType>& s2)
+	      const HilbertState<CorDOperatorType,
+	                         DiagonalOperatorType,
+	                         OperatorStringType>& s1,
+	      const HilbertState<CorDOperatorType,
+	                         DiagonalOperatorType,
+	                         OperatorStringType>& s2)
 	{
-		HilbertState<CorDOperatorType,DiagonalOperatorType> s3 = s2;
+		HilbertState<CorDOperatorType,
+		             DiagonalOperatorType,
+		             OperatorStringType> s3 = s2;
 		return s3.pourAndClose(s1);
 	}
 
+	//! <s1|s2> as residues at the poles of its diagonal operator
+	template<typename CorDOperatorType,
+	         typename DiagonalOperatorType,
+	         typename OperatorStringType>
+	void scalarProduct(
+	      Poles<typename CorDOperatorType::RealType,
+	            typename CorDOperatorType::FieldType>& poles,
+	      const HilbertState<CorDOperatorType,
+	                         DiagonalOperatorType,
+	                         OperatorStringType>& s1,
+	      const HilbertState<CorDOperatorType,
+	                         DiagonalOperatorType,
+	                         OperatorStringType>& s2)
+	{
+		HilbertState<CorDOperatorType,
+		             DiagonalOperatorType,
+		             OperatorStringType> s3 = s2;
+		s3.pourAndClose(s1,poles);
+	}
+
+	//! values[i] = <s1|s2> for the i-th point of the parameter grids
+	template<typename CorDOperatorType,
+	         typename DiagonalOperatorType,
+	         typename OperatorStringType>
+	void scalarProduct(
+	      std::vector<typename CorDOperatorType::FieldType>& values,
+	      const HilbertState<CorDOperatorType,
+	                         DiagonalOperatorType,
+	                         OperatorStringType>& s1,
+	      const HilbertState<CorDOperatorType,
+	                         DiagonalOperatorType,
+	                         OperatorStringType>& s2)
+	{
+		HilbertState<CorDOperatorType,
+		             DiagonalOperatorType,
+		             OperatorStringType> s3 = s2;
+		s3.pourAndClose(s1,values);
+	}
+
+	//! mc.values()[i] estimates <s1|s2> for the i-th point of the
+	//! parameter grids, with standard errors mc.errors()[i]
+	template<typename CorDOperatorType,
+	         typename DiagonalOperatorType,
+	         typename OperatorStringType,
+	         typename ConcurrencyType>
+	void scalarProduct(
+	      MonteCarlo<typename CorDOperatorType::RealType,
+	                 typename CorDOperatorType::FieldType>& mc,
+	      const HilbertState<CorDOperatorType,
+	                         DiagonalOperatorType,
+	                         OperatorStringType>& s1,
+	      const HilbertState<CorDOperatorType,
+	                         DiagonalOperatorType,
+	                         OperatorStringType>& s2,
+	      ConcurrencyType& concurrency)
+	{
+		HilbertState<CorDOperatorType,
+		             DiagonalOperatorType,
+		             OperatorStringType> s3 = s2;
+		s3.pourAndClose(s1,mc,concurrency);
+	}
+
+	//! What scalarProduct(values,s1,s2) would cost, see HilbertState::dryRun()
+	template<typename CorDOperatorType,
+	         typename DiagonalOperatorType,
+	         typename OperatorStringType>
+	void dryRun(
+	      DryRun<typename CorDOperatorType::RealType>& dry,
+	      const HilbertState<CorDOperatorType,
+	                         DiagonalOperatorType,
+	                         OperatorStringType>& s1,
+	      const HilbertState<CorDOperatorType,
+	                         DiagonalOperatorType,
+	                         OperatorStringType>& s2,
+	      size_t samples = 64)
+	{
+		HilbertState<CorDOperatorType,
+		             DiagonalOperatorType,
+		             OperatorStringType> s3 = s2;
+		s3.dryRun(s1,dry,samples);
+	}
+
+	//! m(i,j) = <states[i]|states[j]>, only i<=j are closed
+	//! Rows are distributed over concurrency, m is complete on the root
+	template<typename CorDOperatorType,
+	         typename DiagonalOperatorType,
+	         typename OperatorStringType,
+	         typename ConcurrencyType>
+	void gramMatrix(
+	      PsimagLite::Matrix<typename CorDOperatorType::FieldType>& m,
+	      const std::vector<HilbertState<CorDOperatorType,
+	                                     DiagonalOperatorType,
+	                                     OperatorStringType> >& states,
+	      ConcurrencyType& concurrency)
+	{
+		typedef typename CorDOperatorType::FieldType FieldType;
+		size_t n = states.size();
+		std::vector<std::vector<FieldType> > rows(n);
+		PsimagLite::Range<ConcurrencyType> range(0,n,concurrency);
+		for (;!range.end();range.next()) {
+			size_t i = range.index();
+			rows[i].resize(n,0);
+			for (size_t j=i;j<n;j++)
+				rows[i][j] = scalarProduct(states[i],states[j]);
+		}
+		concurrency.gather(rows);
+
+		m.resize(n,n);
+		if (!concurrency.root()) return;
+		for (size_t i=0;i<n;i++) {
+			for (size_t j=i;j<n;j++) {
+				m(j,i) = std::conj(rows[i][j]);
+				m(i,j) = rows[i][j];
+			}
+		}
+	}
+
 } // namespace Dmrg 
 
 /*@}*/
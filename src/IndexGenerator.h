@@ -87,24 +87,31 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 
 namespace FreeFermions {
 	
+	// All n-tuples of 0..ne-1 in reflected Gray order: each increase()
+	// changes one index by one, see changed() and previous()
+	// Loopless, as Knuth's TAOCP 7.2.1.1 Algorithm H
 	class IndexGenerator {
 	public:
 		typedef size_t value_type;
-		IndexGenerator(size_t n,size_t ne) : data_(n,0),ne_(ne) {}
+		IndexGenerator(size_t n,size_t ne)
+		: data_(n,0),ne_(ne),directions_(n,1),focus_(n+1),changed_(0),previous_(0)
+		{
+			for (size_t i=0;i<focus_.size();i++) focus_[i] = i;
+		}
 
 		bool increase()
 		{
-			if (data_.size()==0) return false;
-			size_t c = 0;
-			while(true) {
-				data_[c]++;
-				if (data_[c]==ne_) {
-					if (c==data_.size()-1) return false;
-					data_[c] = 0;
-					c++;
-				} else {
-					break;
-				}
+			if (data_.size()==0 || ne_<2) return false;
+			size_t c = focus_[0];
+			focus_[0] = 0;
+			if (c==data_.size()) return false;
+			changed_ = c;
+			previous_ = data_[c];
+			data_[c] += directions_[c];
+			if (data_[c]==0 || data_[c]==ne_-1) {
+				directions_[c] = -directions_[c];
+				focus_[c] = focus_[c+1];
+				focus_[c+1] = c+1;
 			}
 			return true;
 		}
@@ -116,11 +123,21 @@ namespace FreeFermions {
 
 		size_t size() const { return data_.size(); }
 
+		//! The index the last increase() changed
+		size_t changed() const { return changed_; }
+
+		//! What that index was before the last increase()
+		size_t previous() const { return previous_; }
+
 // 		size_t max() const { return ne_; }
 
 	private:
 		std::vector<size_t> data_;
 		size_t ne_;
+		std::vector<int> directions_;
+		std::vector<size_t> focus_;
+		size_t changed_;
+		size_t previous_;
 	}; // IndexGenerator
 	
 	std::ostream& operator<<(std::ostream& os,const IndexGenerator& ig)
@@ -84,13 +84,15 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 
 #include "Complex.h" // in PsimagLite
 #include "OperatorFactory.h"
+#include "BilinearOperator.h"
 
 namespace FreeFermions {
 	
 	template<typename OperatorType>
 	class LibraryOperator {
 		typedef LibraryOperator<OperatorType> ThisType;
-		typedef OperatorFactory<OperatorType> OpNormalFactoryType;
+		typedef BilinearOperator<OperatorType> BilinearOperatorType;
+		typedef typename BilinearOperatorType::FactoryType OpBilinearFactoryType;
 	public:
 		typedef typename OperatorType::EngineType EngineType;
 		typedef typename OperatorType::RealType RealType;
@@ -104,20 +106,12 @@ namespace FreeFermions {
 
 		friend class OperatorFactory<ThisType>;
 
+		//! N and NBAR are c^dagger c and c c^dagger on one site
 		template<typename SomeStateType>
 		void applyTo(SomeStateType& state)
 		{
-			OperatorType& op = opNormalFactory_(DESTRUCTION,ind_,sigma_);
-			OperatorType& op2 = opNormalFactory_(CREATION,ind_,sigma_);
-
-			if (type_==N) {
-				state.pushInto(op);
-				state.pushInto(op2);
-			} else if (type_==NBAR){
-				state.pushInto(op2);
-				state.pushInto(op);
-			}
-
+			if (!bilinear_) return;
+			state.pushInto(*bilinear_);
 		}
 
 	private:
@@ -127,8 +121,21 @@ namespace FreeFermions {
 				size_t type,
 				size_t ind,
 				size_t sigma)
-		: opNormalFactory_(engine),type_(type),ind_(ind),sigma_(sigma)
-		{}
+		: opBilinearFactory_(engine),
+		  type_(type),
+		  ind_(ind),
+		  sigma_(sigma),
+		  bilinear_(0)
+		{
+			if (type_==N)
+				bilinear_ = &opBilinearFactory_(BilinearOperatorType::NORMAL,
+				                                ind_,
+				                                sigma_);
+			else if (type_==NBAR)
+				bilinear_ = &opBilinearFactory_(BilinearOperatorType::ANTINORMAL,
+				                                ind_,
+				                                sigma_);
+		}
 
 		LibraryOperator(const ThisType& x)
 		{
@@ -142,8 +149,9 @@ namespace FreeFermions {
 			  "LibraryOperator::assignmentOp: Don't even think of coming here\n");
 		}
 
-		OpNormalFactoryType opNormalFactory_;
+		OpBilinearFactoryType opBilinearFactory_;
 		size_t type_,ind_,sigma_;
+		const BilinearOperatorType* bilinear_;
 	}; // LibraryOperator
 	
 
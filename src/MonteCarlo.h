@@ -0,0 +1,234 @@
+// BEGIN LICENSE BLOCK
+/*
+Copyright (c) 2011 , UT-Battelle, LLC
+All rights reserved
+
+[FreeFermions, Version 1.0.0]
+[by G.A., Oak Ridge National Laboratory]
+
+UT Battelle Open Source Software License 11242008
+
+OPEN SOURCE LICENSE
+
+Subject to the conditions of this License, each
+contributor to this software hereby grants, free of
+charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), a
+perpetual, worldwide, non-exclusive, no-charge,
+royalty-free, irrevocable copyright license to use, copy,
+modify, merge, publish, distribute, and/or sublicense
+copies of the Software.
+
+1. Redistributions of Software must retain the above
+copyright and license notices, this list of conditions,
+and the following disclaimer.  Changes or modifications
+to, or derivative works of, the Software should be noted
+with comments and the contributor and organization's
+name.
+
+2. Neither the names of UT-Battelle, LLC or the
+Department of Energy nor the names of the Software
+contributors may be used to endorse or promote products
+derived from this software without specific prior written
+permission of UT-Battelle.
+
+3. The software and the end-user documentation included
+with the redistribution, with or without modification,
+must include the following acknowledgment:
+
+"This product includes software produced by UT-Battelle,
+LLC under Contract No. DE-AC05-00OR22725  with the
+Department of Energy."
+ 
+*********************************************************
+DISCLAIMER
+
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+COPYRIGHT OWNER, CONTRIBUTORS, UNITED STATES GOVERNMENT,
+OR THE UNITED STATES DEPARTMENT OF ENERGY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+DAMAGE.
+
+NEITHER THE UNITED STATES GOVERNMENT, NOR THE UNITED
+STATES DEPARTMENT OF ENERGY, NOR THE COPYRIGHT OWNER, NOR
+ANY OF THEIR EMPLOYEES, REPRESENTS THAT THE USE OF ANY
+INFORMATION, DATA, APPARATUS, PRODUCT, OR PROCESS
+DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
+
+*********************************************************
+
+
+*/
+// END LICENSE BLOCK
+/** \ingroup DMRG */
+/*@{*/
+
+/*! \file MonteCarlo.h
+ *
+ * Closed products too large to enumerate, estimated from random tuples
+ * of lambdas drawn in proportion to their amplitudes
+ *
+ */
+#ifndef MONTE_CARLO_H
+#define MONTE_CARLO_H
+
+#include <vector>
+#include <algorithm>
+#include <iostream>
+
+namespace FreeFermions {
+
+	//! Uniform numbers in [0,1), one stream per (seed,stream) pair, so
+	//! streams don't depend on how they're spread over processes
+	//! Marsaglia's xorshift128, seeded by mixing seed and stream
+	class RandomStream {
+	public:
+
+		RandomStream(size_t seed,size_t stream)
+		{
+			unsigned int x = mix(mix(seed) + stream);
+			for (size_t i=0;i<4;i++) state_[i] = x = mix(x + 0x9e3779b9u);
+			if ((state_[0] | state_[1] | state_[2] | state_[3])==0) state_[0] = 1;
+		}
+
+		double operator()()
+		{
+			unsigned int t = state_[3];
+			unsigned int s = state_[0];
+			state_[3] = state_[2];
+			state_[2] = state_[1];
+			state_[1] = s;
+			t ^= t<<11;
+			t ^= t>>8;
+			state_[0] = t ^ s ^ (s>>19);
+			return state_[0]*(1.0/4294967296.0);
+		}
+
+	private:
+
+		// the finalizer of MurmurHash3
+		static unsigned int mix(unsigned int x)
+		{
+			x ^= x>>16;
+			x *= 0x85ebca6bu;
+			x ^= x>>13;
+			x *= 0xc2b2ae35u;
+			x ^= x>>16;
+			return x;
+		}
+
+		unsigned int state_[4];
+	}; // RandomStream
+
+	//! Tuples of lambdas, each drawn on its own with probability
+	//! proportional to its bound, see EvaluationPlan::bounds()
+	template<typename RealType>
+	class LambdaSampler {
+	public:
+		typedef size_t value_type;
+
+		LambdaSampler(const std::vector<std::vector<RealType> >& bounds)
+		: cumulative_(bounds.size()),data_(bounds.size(),0),valid_(true)
+		{
+			for (size_t i=0;i<bounds.size();i++) {
+				RealType sum = 0;
+				for (size_t lambda=0;lambda<bounds[i].size();lambda++) {
+					sum += bounds[i][lambda];
+					cumulative_[i].push_back(sum);
+				}
+				if (sum<=0) valid_ = false;
+			}
+		}
+
+		//! False if some lambda has no level with a non-zero bound
+		bool valid() const { return valid_; }
+
+		//! Draws a tuple and returns its probability
+		RealType draw(RandomStream& random)
+		{
+			RealType probability = 1;
+			for (size_t i=0;i<cumulative_.size();i++) {
+				const std::vector<RealType>& c = cumulative_[i];
+				RealType total = c.back();
+				RealType x = random()*total;
+				size_t lambda = std::upper_bound(c.begin(),c.end(),x) - c.begin();
+				if (lambda==c.size()) lambda--;
+				RealType below = (lambda>0) ? c[lambda-1] : 0;
+				probability *= (c[lambda]-below)/total;
+				data_[i] = lambda;
+			}
+			return probability;
+		}
+
+		size_t operator[](size_t i) const { return data_[i]; }
+
+		size_t size() const { return data_.size(); }
+
+	private:
+
+		std::vector<std::vector<RealType> > cumulative_;
+		std::vector<size_t> data_;
+		bool valid_;
+	}; // LambdaSampler
+
+	template<typename RealType>
+	std::ostream& operator<<(std::ostream& os,
+	                         const LambdaSampler<RealType>& sampler)
+	{
+		for (size_t i=0;i<sampler.size();i++) os<<sampler[i]<<" ";
+		return os;
+	}
+
+	//! A stochastic close: streams() independent streams of samples()
+	//! tuples each; the same seed gives the same estimate
+	template<typename RealType,typename FieldType>
+	class MonteCarlo {
+	public:
+
+		MonteCarlo(size_t samples,size_t streams = 1,size_t seed = 1)
+		: samples_(samples),streams_(streams),seed_(seed)
+		{}
+
+		//! Tuples drawn per stream
+		size_t samples() const { return samples_; }
+
+		size_t streams() const { return streams_; }
+
+		size_t seed() const { return seed_; }
+
+		//! values()[i] estimates the closed product at the i-th point of
+		//! the grids, errors()[i] is its standard error
+		const std::vector<FieldType>& values() const { return values_; }
+
+		const std::vector<RealType>& errors() const { return errors_; }
+
+		void set(const std::vector<FieldType>& values,
+		         const std::vector<RealType>& errors)
+		{
+			values_ = values;
+			errors_ = errors;
+		}
+
+	private:
+
+		size_t samples_;
+		size_t streams_;
+		size_t seed_;
+		std::vector<FieldType> values_;
+		std::vector<RealType> errors_;
+	}; // MonteCarlo
+} // namespace FreeFermions
+
+/*@}*/
+#endif // MONTE_CARLO_H
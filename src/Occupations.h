@@ -0,0 +1,174 @@
+// BEGIN LICENSE BLOCK
+/*
+Copyright (c) 2011 , UT-Battelle, LLC
+All rights reserved
+
+[FreeFermions, Version 1.0.0]
+[by G.A., Oak Ridge National Laboratory]
+
+UT Battelle Open Source Software License 11242008
+
+OPEN SOURCE LICENSE
+
+Subject to the conditions of this License, each
+contributor to this software hereby grants, free of
+charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), a
+perpetual, worldwide, non-exclusive, no-charge,
+royalty-free, irrevocable copyright license to use, copy,
+modify, merge, publish, distribute, and/or sublicense
+copies of the Software.
+
+1. Redistributions of Software must retain the above
+copyright and license notices, this list of conditions,
+and the following disclaimer.  Changes or modifications
+to, or derivative works of, the Software should be noted
+with comments and the contributor and organization's
+name.
+
+2. Neither the names of UT-Battelle, LLC or the
+Department of Energy nor the names of the Software
+contributors may be used to endorse or promote products
+derived from this software without specific prior written
+permission of UT-Battelle.
+
+3. The software and the end-user documentation included
+with the redistribution, with or without modification,
+must include the following acknowledgment:
+
+"This product includes software produced by UT-Battelle,
+LLC under Contract No. DE-AC05-00OR22725  with the
+Department of Energy."
+ 
+*********************************************************
+DISCLAIMER
+
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+COPYRIGHT OWNER, CONTRIBUTORS, UNITED STATES GOVERNMENT,
+OR THE UNITED STATES DEPARTMENT OF ENERGY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+DAMAGE.
+
+NEITHER THE UNITED STATES GOVERNMENT, NOR THE UNITED
+STATES DEPARTMENT OF ENERGY, NOR THE COPYRIGHT OWNER, NOR
+ANY OF THEIR EMPLOYEES, REPRESENTS THAT THE USE OF ANY
+INFORMATION, DATA, APPARATUS, PRODUCT, OR PROCESS
+DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
+
+*********************************************************
+
+
+*/
+// END LICENSE BLOCK
+/** \ingroup DMRG */
+/*@{*/
+
+/*! \file Occupations.h
+ *
+ * Occupations of the levels of one flavor, packed one bit per level
+ *
+ */
+#ifndef OCCUPATIONS_H
+#define OCCUPATIONS_H
+
+#include <vector>
+#include <cstddef>
+
+namespace FreeFermions {
+
+	class Occupations {
+
+	public:
+
+		typedef unsigned long WordType;
+
+	private:
+
+		enum {BITS = sizeof(WordType)*8};
+
+	public:
+
+		Occupations() : size_(0) {}
+
+		//! The lowest ne of n levels are filled
+		Occupations(size_t n,size_t ne)
+		: words_((n+BITS-1)/BITS,0),size_(n)
+		{
+			for (size_t i=0;i<ne && i<n;i++) set(i,1);
+		}
+
+		//! From one entry per level, non-zero if the level is filled
+		Occupations(const std::vector<size_t>& v)
+		: words_((v.size()+BITS-1)/BITS,0),size_(v.size())
+		{
+			for (size_t i=0;i<v.size();i++) if (v[i]!=0) set(i,1);
+		}
+
+		//! 1 if level i is filled, else 0
+		size_t operator[](size_t i) const
+		{
+			return (words_[i/BITS]>>(i%BITS)) & 1;
+		}
+
+		void set(size_t i,size_t value)
+		{
+			WordType bit = WordType(1)<<(i%BITS);
+			if (value) words_[i/BITS] |= bit;
+			else words_[i/BITS] &= ~bit;
+		}
+
+		//! Number of levels
+		size_t size() const { return size_; }
+
+		//! Number of filled levels
+		size_t count() const
+		{
+			size_t counter = 0;
+			for (size_t i=0;i<words_.size();i++)
+				for (WordType w = words_[i];w;w &= w-1) counter++;
+			return counter;
+		}
+
+		//! Appends the levels where this and other differ, in order
+		void differences(std::vector<size_t>& levels,const Occupations& other) const
+		{
+			for (size_t i=0;i<words_.size();i++) {
+				WordType w = words_[i] ^ other.words_[i];
+				for (size_t j=i*BITS;w;w >>= 1,j++)
+					if (w & 1) levels.push_back(j);
+			}
+		}
+
+		bool operator==(const Occupations& other) const
+		{
+			return (size_==other.size_ && words_==other.words_);
+		}
+
+		bool operator!=(const Occupations& other) const
+		{
+			return !(*this==other);
+		}
+
+		//! The bits, level i being bit i%BITS of word i/BITS
+		const std::vector<WordType>& words() const { return words_; }
+
+	private:
+
+		std::vector<WordType> words_;
+		size_t size_;
+	}; // Occupations
+} // namespace FreeFermions
+
+/*@}*/
+#endif // OCCUPATIONS_H
@@ -80,6 +80,8 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 #ifndef ONE_OVER_Z_MINUS_H_H
 #define ONE_OVER_Z_MINUS_H_H
 
+#include <vector>
+#include "FreeOperators.h"
 
 namespace FreeFermions {
 	// All interactions == 0
@@ -94,37 +96,131 @@ namespace FreeFermions {
 			               int sign,
 				       const RealType& offset,
 			               const EngineType& engine)
-			: z_(z),
+			: zs_(1,z),
 			  sign_(sign),
 			  offset_(offset),
-			  engine_(engine)
+			  engine_(engine),
+			  margin_(-1),
+			  low_(0),
+			  high_(0),
+			  height_(0)
 			{}
 
+			//! One value per z, in one enumeration
+			OneOverZminusH(const std::vector<FieldType>& zs,
+			               int sign,
+				       const RealType& offset,
+			               const EngineType& engine)
+			: zs_(zs),
+			  sign_(sign),
+			  offset_(offset),
+			  engine_(engine),
+			  margin_(-1),
+			  low_(0),
+			  high_(0),
+			  height_(0)
+			{}
+
+			//! Poles farther than margin from the real parts of the z's
+			//! are dropped, their tails being below 1/|margin + i Im z|
+			void window(const RealType& margin)
+			{
+				margin_ = margin;
+				// conjugating the z's, see transpose(), keeps these
+				low_ = std::real(zs_[0]);
+				high_ = low_;
+				height_ = fabs(std::imag(zs_[0]));
+				for (size_t i=1;i<zs_.size();i++) {
+					low_ = std::min(low_,RealType(std::real(zs_[i])));
+					high_ = std::max(high_,RealType(std::real(zs_[i])));
+					height_ = std::min(height_,RealType(fabs(std::imag(zs_[i]))));
+				}
+			}
+
+			bool windowed() const { return (margin_>=0); }
+
+			//! True if the pole is farther than the margin from the window,
+			//! and then bound is the largest |1/(z-pole)| over the z's
+			bool outside(const RealType& pole,RealType& bound) const
+			{
+				if (margin_<0) return false;
+				RealType distance = (pole<low_) ? low_-pole : pole-high_;
+				if (distance<=margin_) return false;
+				bound = 1.0/sqrt(distance*distance+height_*height_);
+				return true;
+			}
+
 			template<typename FreeOperatorsType>
 			FieldType operator()(const FreeOperatorsType& freeOps,
 			                      size_t loc) const
 			{
-				RealType sum = 0;
-				for (size_t i=0;i<loc;i++) {
-					if (freeOps[i].type != FreeOperatorsType::CREATION &&
-						freeOps[i].type != FreeOperatorsType::DESTRUCTION)
-						   continue;
-					int sign =  (freeOps[i].type ==
-							       FreeOperatorsType::CREATION) ? -1 : 1;
-					sum += engine_.eigenvalue(freeOps[i].lambda)*sign;
-				}
-				//if (fabs(time_)>1000.0) return sum;
-				return 1.0/(z_-sign_*(sum+offset_));
+				return value(pole(energyAt(freeOps,loc,engine_)));
+			}
+
+			//! Where this operator has its pole, for a state of this energy
+			RealType pole(const RealType& energy) const
+			{
+				return sign_*(offset_-energy);
 			}
 
-			void transpose() { z_ = std::conj(z_); }
+			//! 1/(z-H) of independent flavors isn't the product of theirs,
+			//! so the energies of all flavors must be added first
+			bool multiplicative() const { return false; }
+
+			//! This operator for the first z at a given pole
+			FieldType value(const RealType& pole) const
+			{
+				return 1.0/(zs_[0]-pole);
+			}
+
+			//! v[i] is this operator for the i-th z at a given pole
+			void values(std::vector<FieldType>& v,const RealType& pole) const
+			{
+				v.resize(zs_.size());
+				for (size_t i=0;i<zs_.size();i++)
+					v[i] = 1.0/(zs_[i]-pole);
+			}
+
+			//! Number of points of the z grid
+			size_t size() const { return zs_.size(); }
+
+			//! v[i] is this operator for the i-th z
+			template<typename FreeOperatorsType>
+			void operator()(std::vector<FieldType>& v,
+			                const FreeOperatorsType& freeOps,
+			                size_t loc) const
+			{
+				values(v,pole(energyAt(freeOps,loc,engine_)));
+			}
+
+			void transpose()
+			{
+				for (size_t i=0;i<zs_.size();i++) zs_[i] = std::conj(zs_[i]);
+			}
+
+			//! Appends what defines this operator to key
+			template<typename KeyType>
+			void key(KeyType& key) const
+			{
+				key.append(zs_.size());
+				for (size_t i=0;i<zs_.size();i++) key.append(zs_[i]);
+				key.append(sign_);
+				key.append(offset_);
+				key.append(margin_);
+			}
+
+			const EngineType& engine() const { return engine_; }
 
 		private:
-			
-			FieldType z_;
+
+			std::vector<FieldType> zs_;
 			int sign_;
 			RealType offset_;
 			const EngineType& engine_;
+			RealType margin_;
+			RealType low_;
+			RealType high_;
+			RealType height_;
 	}; // OneOverZminusH
 } // namespace Dmrg 
 
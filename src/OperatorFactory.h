@@ -82,15 +82,19 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 #ifndef OPERATOR_FACTORY_H
 #define OPERATOR_FACTORY_H
 
+#include "SharedPointer.h"
 
 namespace FreeFermions {
 
+	//! Operators live as long as their factory. Not thread safe, each
+	//! thread makes its own; one Engine may be shared by all of them
 	template<typename OpType>
 	class OperatorFactory {
 		typedef typename OpType::EngineType EngineType;
 		typedef OperatorFactory<OpType> ThisType;
 
 	public:
+			typedef SharedPointer<const OpType> HandleType;
 
 			OperatorFactory(const EngineType& engine) : engine_(&engine)
 			{}
@@ -123,6 +127,13 @@ namespace FreeFermions {
 				return *op2;
 			}
 
+			//! A copy of op that lives as long as its handles, whatever
+			//! the thread and the factory; states can hold it
+			static HandleType share(const OpType& op)
+			{
+				return HandleType(new OpType(&op));
+			}
+
 		private:
 
 			const EngineType* engine_;
@@ -0,0 +1,193 @@
+// BEGIN LICENSE BLOCK
+/*
+Copyright (c) 2011 , UT-Battelle, LLC
+All rights reserved
+
+[FreeFermions, Version 1.0.0]
+[by G.A., Oak Ridge National Laboratory]
+
+UT Battelle Open Source Software License 11242008
+
+OPEN SOURCE LICENSE
+
+Subject to the conditions of this License, each
+contributor to this software hereby grants, free of
+charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), a
+perpetual, worldwide, non-exclusive, no-charge,
+royalty-free, irrevocable copyright license to use, copy,
+modify, merge, publish, distribute, and/or sublicense
+copies of the Software.
+
+1. Redistributions of Software must retain the above
+copyright and license notices, this list of conditions,
+and the following disclaimer.  Changes or modifications
+to, or derivative works of, the Software should be noted
+with comments and the contributor and organization's
+name.
+
+2. Neither the names of UT-Battelle, LLC or the
+Department of Energy nor the names of the Software
+contributors may be used to endorse or promote products
+derived from this software without specific prior written
+permission of UT-Battelle.
+
+3. The software and the end-user documentation included
+with the redistribution, with or without modification,
+must include the following acknowledgment:
+
+"This product includes software produced by UT-Battelle,
+LLC under Contract No. DE-AC05-00OR22725  with the
+Department of Energy."
+ 
+*********************************************************
+DISCLAIMER
+
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+COPYRIGHT OWNER, CONTRIBUTORS, UNITED STATES GOVERNMENT,
+OR THE UNITED STATES DEPARTMENT OF ENERGY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+DAMAGE.
+
+NEITHER THE UNITED STATES GOVERNMENT, NOR THE UNITED
+STATES DEPARTMENT OF ENERGY, NOR THE COPYRIGHT OWNER, NOR
+ANY OF THEIR EMPLOYEES, REPRESENTS THAT THE USE OF ANY
+INFORMATION, DATA, APPARATUS, PRODUCT, OR PROCESS
+DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
+
+*********************************************************
+
+
+*/
+// END LICENSE BLOCK
+/** \ingroup DMRG */
+/*@{*/
+
+/*! \file OperatorString.h
+ *
+ * Closed products whose shape is known at compile time: the types of
+ * their operators, in the order they act on the ket, as a type
+ *
+ */
+#ifndef OPERATOR_STRING_H
+#define OPERATOR_STRING_H
+
+#include "FreeOperators.h"
+
+namespace FreeFermions {
+
+	//! Any string of operators, evaluated by the runtime path
+	struct AnyString {
+		enum {FIXED = 0,LENGTH = 0};
+
+		static void types(size_t*) {}
+	};
+
+	// what ends a fixed string
+	struct EmptyString {
+		enum {FIXED = 1,LENGTH = 0};
+
+		static void types(size_t*) {}
+	};
+
+	//! An operator of type Type, then the rest of the string
+	template<size_t Type,typename TailType = EmptyString>
+	struct OperatorString {
+		enum {FIXED = 1,LENGTH = 1 + TailType::LENGTH};
+
+		//! Writes the types of the string into t, which holds LENGTH
+		static void types(size_t* t)
+		{
+			t[0] = Type;
+			TailType::types(t+1);
+		}
+	};
+
+	//! The strings of the usual correlators, for operators of this type
+	template<typename CorDOperatorType>
+	struct OperatorStrings {
+		enum {CREATION = CorDOperatorType::CREATION,
+		      DESTRUCTION = CorDOperatorType::DESTRUCTION,
+		      DIAGONAL
+		};
+
+		//! <c^\dagger_i c_j>, c_j acting first
+		typedef OperatorString<DESTRUCTION,
+		                       OperatorString<CREATION> > HoppingType;
+
+		//! <n_i n_j>
+		typedef OperatorString<DESTRUCTION,
+		                       OperatorString<CREATION,
+		                                      HoppingType> > DensityDensityType;
+
+		//! <c^\dagger_i c_j X c^\dagger_k c_l>, X a diagonal operator
+		typedef OperatorString<DESTRUCTION,
+		                       OperatorString<CREATION,
+		                                      OperatorString<DIAGONAL,
+		                                                     HoppingType> > >
+		                                                 HoppingDiagonalHoppingType;
+	};
+
+	//! FreeOperators for a fixed string: the lambdas of one flavor in
+	//! an array of the string's length, with the diagonals in place
+	template<typename OperatorType,typename OperatorStringType>
+	class FixedFreeOperators {
+
+		enum {LENGTH = OperatorStringType::LENGTH};
+
+	public:
+
+		enum {CREATION = OperatorType::CREATION,
+		      DESTRUCTION = OperatorType::DESTRUCTION
+		};
+
+		FixedFreeOperators()
+		{
+			size_t types[LENGTH];
+			OperatorStringType::types(types);
+			for (size_t i=0;i<LENGTH;i++) {
+				data_[i].type = types[i];
+				data_[i].lambda = 0;
+			}
+		}
+
+		//! The C's take lambda, the D's lambda2, in order
+		template<typename LambdaType,typename Lambda2Type>
+		void fill(const LambdaType& lambda,const Lambda2Type& lambda2)
+		{
+			size_t c = 0;
+			size_t d = 0;
+			for (size_t i=0;i<LENGTH;i++) {
+				if (data_[i].type==CREATION) data_[i].lambda = lambda[c++];
+				else if (data_[i].type==DESTRUCTION) data_[i].lambda = lambda2[d++];
+			}
+		}
+
+		size_t size() const { return LENGTH; }
+
+		const FreeOperator& operator[](size_t i) const { return data_[i]; }
+
+		bool notCreationOrDestruction(size_t type1) const
+		{
+			return (type1!=CREATION && type1!=DESTRUCTION);
+		}
+
+	private:
+
+		FreeOperator data_[LENGTH];
+	}; // FixedFreeOperators
+} // namespace FreeFermions
+
+/*@}*/
+#endif // OPERATOR_STRING_H
@@ -0,0 +1,160 @@
+// BEGIN LICENSE BLOCK
+/*
+Copyright (c) 2011 , UT-Battelle, LLC
+All rights reserved
+
+[FreeFermions, Version 1.0.0]
+[by G.A., Oak Ridge National Laboratory]
+
+UT Battelle Open Source Software License 11242008
+
+OPEN SOURCE LICENSE
+
+Subject to the conditions of this License, each
+contributor to this software hereby grants, free of
+charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), a
+perpetual, worldwide, non-exclusive, no-charge,
+royalty-free, irrevocable copyright license to use, copy,
+modify, merge, publish, distribute, and/or sublicense
+copies of the Software.
+
+1. Redistributions of Software must retain the above
+copyright and license notices, this list of conditions,
+and the following disclaimer.  Changes or modifications
+to, or derivative works of, the Software should be noted
+with comments and the contributor and organization's
+name.
+
+2. Neither the names of UT-Battelle, LLC or the
+Department of Energy nor the names of the Software
+contributors may be used to endorse or promote products
+derived from this software without specific prior written
+permission of UT-Battelle.
+
+3. The software and the end-user documentation included
+with the redistribution, with or without modification,
+must include the following acknowledgment:
+
+"This product includes software produced by UT-Battelle,
+LLC under Contract No. DE-AC05-00OR22725  with the
+Department of Energy."
+ 
+*********************************************************
+DISCLAIMER
+
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+COPYRIGHT OWNER, CONTRIBUTORS, UNITED STATES GOVERNMENT,
+OR THE UNITED STATES DEPARTMENT OF ENERGY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+DAMAGE.
+
+NEITHER THE UNITED STATES GOVERNMENT, NOR THE UNITED
+STATES DEPARTMENT OF ENERGY, NOR THE COPYRIGHT OWNER, NOR
+ANY OF THEIR EMPLOYEES, REPRESENTS THAT THE USE OF ANY
+INFORMATION, DATA, APPARATUS, PRODUCT, OR PROCESS
+DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
+
+*********************************************************
+
+
+*/
+// END LICENSE BLOCK
+/** \ingroup DMRG */
+/*@{*/
+
+/*! \file ParticleHole.h
+ *
+ * The filled band of one flavor taken as the vacuum,
+ * so that more than half filled states are built from holes
+ *
+ */
+#ifndef PARTICLE_HOLE_H
+#define PARTICLE_HOLE_H
+
+#include "Complex.h" // in PsimagLite
+#include <vector>
+#include "Occupations.h"
+
+namespace FreeFermions {
+
+	template<typename EngineType>
+	class ParticleHole {
+
+		typedef typename EngineType::RealType RealType;
+
+	public:
+
+		ParticleHole(const EngineType& engine,
+		             const Occupations& occupations,
+		             const Occupations& occupations2)
+		: ne_(0),ne2_(0),sign_(1),energy_(0)
+		{
+			if (occupations.size()!=occupations2.size())
+				throw std::runtime_error("ParticleHole::ctor(...)\n");
+
+			for (size_t i=0;i<engine.size();i++)
+				energy_ += engine.eigenvalue(i);
+
+			// |occ> = sign(occ) ... c_{h_2} c_{h_1} |full>, for holes
+			// h_1 < h_2 < ...,  see FreeOperators::addAtTheFront()
+			sign_ = signOf(occupations,ne_) * signOf(occupations2,ne2_);
+		}
+
+		//! Enough electrons so that holes are fewer than particles?
+		static bool isWorthIt(const Occupations& occupations,
+		                      const Occupations& occupations2)
+		{
+			return (occupations.count()+occupations2.count()>occupations.size());
+		}
+
+		//! Number of levels filled in the ket
+		size_t ne() const { return ne_; }
+
+		//! Number of levels filled in the bra
+		size_t ne2() const { return ne2_; }
+
+		//! Sign relating the particle and the hole representations
+		int sign() const { return sign_; }
+
+		//! Sum of the eigenvalues of all levels
+		const RealType& energy() const { return energy_; }
+
+	private:
+
+		int signOf(const Occupations& occupations,size_t& ne) const
+		{
+			int sign = 1;
+			ne = 0;
+			size_t n = occupations.size();
+			for (size_t i=0;i<n;i++) {
+				if (occupations[i]!=0) {
+					ne++;
+					continue;
+				}
+				// holes below i were already made, so n-1-i electrons above
+				if ((n-1-i) & 1) sign = -sign;
+			}
+			return sign;
+		}
+
+		size_t ne_;
+		size_t ne2_;
+		int sign_;
+		RealType energy_;
+	}; // ParticleHole
+} // namespace FreeFermions
+
+/*@}*/
+#endif // PARTICLE_HOLE_H
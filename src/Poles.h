@@ -0,0 +1,214 @@
+// BEGIN LICENSE BLOCK
+/*
+Copyright (c) 2011 , UT-Battelle, LLC
+All rights reserved
+
+[FreeFermions, Version 1.0.0]
+[by G.A., Oak Ridge National Laboratory]
+
+UT Battelle Open Source Software License 11242008
+
+OPEN SOURCE LICENSE
+
+Subject to the conditions of this License, each
+contributor to this software hereby grants, free of
+charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), a
+perpetual, worldwide, non-exclusive, no-charge,
+royalty-free, irrevocable copyright license to use, copy,
+modify, merge, publish, distribute, and/or sublicense
+copies of the Software.
+
+1. Redistributions of Software must retain the above
+copyright and license notices, this list of conditions,
+and the following disclaimer.  Changes or modifications
+to, or derivative works of, the Software should be noted
+with comments and the contributor and organization's
+name.
+
+2. Neither the names of UT-Battelle, LLC or the
+Department of Energy nor the names of the Software
+contributors may be used to endorse or promote products
+derived from this software without specific prior written
+permission of UT-Battelle.
+
+3. The software and the end-user documentation included
+with the redistribution, with or without modification,
+must include the following acknowledgment:
+
+"This product includes software produced by UT-Battelle,
+LLC under Contract No. DE-AC05-00OR22725  with the
+Department of Energy."
+ 
+*********************************************************
+DISCLAIMER
+
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+COPYRIGHT OWNER, CONTRIBUTORS, UNITED STATES GOVERNMENT,
+OR THE UNITED STATES DEPARTMENT OF ENERGY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+DAMAGE.
+
+NEITHER THE UNITED STATES GOVERNMENT, NOR THE UNITED
+STATES DEPARTMENT OF ENERGY, NOR THE COPYRIGHT OWNER, NOR
+ANY OF THEIR EMPLOYEES, REPRESENTS THAT THE USE OF ANY
+INFORMATION, DATA, APPARATUS, PRODUCT, OR PROCESS
+DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
+
+*********************************************************
+
+
+*/
+// END LICENSE BLOCK
+/** \ingroup DMRG */
+/*@{*/
+
+/*! \file Poles.h
+ *
+ * Residues of a product at the energies of its intermediate states
+ *
+ */
+#ifndef POLES_H
+#define POLES_H
+
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+namespace FreeFermions {
+
+	// A product <A f(H) B> for free fermions is sum_k r_k f(E_k):
+	// the E_k are energies of H, and the r_k don't depend on the
+	// parameters (time, z, beta) of f; the backend turns each E_k
+	// into its pole only when evaluated, see operator()
+	template<typename RealType,typename FieldType>
+	class Poles {
+	public:
+
+		Poles(RealType tolerance = 1e-8)
+		: tolerance_(tolerance)
+		{}
+
+		//! Reads what operator<< wrote
+		Poles(std::istream& is)
+		{
+			size_t n = 0;
+			is>>tolerance_;
+			is>>n;
+			for (size_t i=0;i<n;i++) {
+				RealType energy = 0;
+				FieldType residue = 0;
+				is>>energy;
+				is>>residue;
+				add(energy,residue);
+			}
+			if (!is) throw std::runtime_error("Poles::Poles(): cannot read\n");
+		}
+
+		//! Energies closer than the tolerance are merged
+		void add(const RealType& energy,const FieldType& residue)
+		{
+			typename std::vector<RealType>::iterator it =
+			        std::lower_bound(energies_.begin(),
+			                         energies_.end(),
+			                         energy-tolerance_);
+			size_t x = it - energies_.begin();
+			if (x<energies_.size() && energies_[x]<=energy+tolerance_) {
+				residues_[x] += residue;
+				return;
+			}
+			energies_.insert(it,energy);
+			residues_.insert(residues_.begin()+x,residue);
+		}
+
+		//! Energies of the product with independent flavors, which add
+		void convolve(const Poles& other)
+		{
+			Poles tmp(tolerance_);
+			for (size_t i=0;i<energies_.size();i++)
+				for (size_t j=0;j<other.size();j++)
+					tmp.add(energies_[i]+other.energy(j),
+					        residues_[i]*other.residue(j));
+			*this = tmp;
+		}
+
+		//! Removes the poles with a residue below epsilon in absolute value
+		void prune(const RealType& epsilon)
+		{
+			size_t j = 0;
+			for (size_t i=0;i<energies_.size();i++) {
+				if (std::abs(residues_[i])<epsilon) continue;
+				energies_[j] = energies_[i];
+				residues_[j++] = residues_[i];
+			}
+			energies_.resize(j);
+			residues_.resize(j);
+		}
+
+		void clear()
+		{
+			energies_.clear();
+			residues_.clear();
+		}
+
+		size_t size() const { return energies_.size(); }
+
+		const RealType& tolerance() const { return tolerance_; }
+
+		const RealType& energy(size_t i) const { return energies_[i]; }
+
+		const FieldType& residue(size_t i) const { return residues_[i]; }
+
+		//! v[i] is the product for the i-th point of the grid of backend
+		template<typename BackendType>
+		void operator()(std::vector<FieldType>& v,
+		                const BackendType& backend) const
+		{
+			v.assign(backend.size(),0.0);
+			std::vector<FieldType> tmp;
+			for (size_t k=0;k<energies_.size();k++) {
+				backend.values(tmp,backend.pole(energies_[k]));
+				for (size_t i=0;i<v.size();i++) v[i] += residues_[k]*tmp[i];
+			}
+		}
+
+		template<typename RealType2,typename FieldType2>
+		friend std::ostream& operator<<(std::ostream& os,
+		                                const Poles<RealType2,FieldType2>& poles);
+
+	private:
+
+		RealType tolerance_;
+		std::vector<RealType> energies_;
+		std::vector<FieldType> residues_;
+	}; // Poles
+
+	template<typename RealType,typename FieldType>
+	std::ostream& operator<<(std::ostream& os,
+	                         const Poles<RealType,FieldType>& poles)
+	{
+		// all digits, so that what's read back is the same
+		std::streamsize precision = os.precision(17);
+		os<<poles.tolerance_<<"\n";
+		os<<poles.size()<<"\n";
+		for (size_t i=0;i<poles.size();i++)
+			os<<poles.energy(i)<<" "<<poles.residue(i)<<"\n";
+		os.precision(precision);
+		return os;
+	}
+} // namespace FreeFermions
+
+/*@}*/
+#endif // POLES_H
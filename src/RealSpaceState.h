@@ -89,6 +89,8 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 #include "Permutations.h"
 #include "ArrangementsWithoutRepetition.h"
 #include "Sort.h"
+#include "BilinearOperator.h"
+#include "DryRun.h"
 
 namespace FreeFermions {
 
@@ -129,12 +131,19 @@ namespace FreeFermions {
 				values_[i] *= x;
 				if (x==0) zeroVals_++;
 			}
+			sorted_ = false;
 			//if (zeroVals_>2000) {
 				killZeroVals();
 				//std::cerr<<"zerovals\n";
 			//}
 		}
 
+		//! A one-term bilinear is its C and its D
+		void pushInto(const BilinearOperator<CorDOperatorType>& op)
+		{
+			op.pushPairInto(*this);
+		}
+
 		FieldType scalarProduct(ThisType& other)
 		{
 			simplify();
@@ -154,6 +163,47 @@ namespace FreeFermions {
 			return sum;
 		}
 
+		//! What a state of ne electrons with operators applied would cost:
+		//! C(n,k) terms, k = min(ne,n-ne), of k! permutations each; the
+		//! costs per term and per permutation are timed with states of
+		//! one and two electrons
+		static void dryRun(DryRun<RealType>& dry,
+		                   const EngineType& engine,
+		                   const std::vector<size_t>& ne,
+		                   size_t operators)
+		{
+			size_t n = engine.size();
+			size_t k = (2*ne[0]>n) ? n - ne[0] : ne[0];
+			RealType terms = 1;
+			RealType permutations = 1;
+			for (size_t i=0;i<k;i++) {
+				terms *= RealType(n-i)/(i+1);
+				permutations *= (i+1);
+			}
+			permutations *= terms;
+
+			// t(k) = perTerm C(n,k) + perPermutation C(n,k) k!
+			RealType perTerm = 0;
+			RealType perPermutation = 0;
+			if (n>=4) {
+				RealType t1 = timeOf(engine,1);
+				RealType t2 = timeOf(engine,2);
+				RealType pairs = n*(n-1)*0.5;
+				perPermutation = std::max(RealType(0),
+				                          (t2 - t1*pairs/n)/pairs);
+				perTerm = std::max(RealType(0),t1/n - perPermutation);
+			}
+			// each operator goes through all terms once more
+			RealType seconds = perTerm*terms*(operators + 1) +
+			                   perPermutation*permutations;
+
+			// terms and values, twice while simplify() copies them
+			RealType bytes = 2*terms*(sizeof(FlavoredStateType) +
+			                          sizeof(std::vector<bool>) + n/8 + 1 +
+			                          sizeof(FieldType));
+			dry.add(terms,permutations,terms,bytes,seconds);
+		}
+
 	private:
 
 		void simplify()
@@ -163,15 +213,18 @@ namespace FreeFermions {
 			killZeroVals();
 			sort();
 
-			FlavoredStateType prev = terms_[0];
 			std::vector<FlavoredStateType> terms2 = terms_;
 			terms_.clear();
 			std::vector<FieldType> values2 = values_;
 			values_.clear();
-			terms_.push_back(prev);
-			values_.push_back(values_[0]);
+			terms_.push_back(terms2[0]);
+			values_.push_back(values2[0]);
 			for (size_t i=1;i<terms2.size();i++) {
-				if (terms2[i] == prev) continue;
+				// equal terms are contiguous after sorting, add them up
+				if (terms2[i] == terms_.back()) {
+					values_.back() += values2[i];
+					continue;
+				}
 				terms_.push_back(terms2[i]);
 				values_.push_back(values2[i]);
 			}
@@ -194,35 +247,57 @@ namespace FreeFermions {
 		// U_{lambda(0),p(0)} U_{lambda(1),p(1)} U_{lambda(2),p(2)}
 		// ... c^\dagger_{p(0)} c^\dagger_{p(1)} c^\dagger_{p(2)}...
 		// where the sum is over all permutations p of 0,1,2 ... N-1
+		// Above half filling the particle-hole transformation is used:
+		// the sum is over the permutations of the empty sites S' and levels L',
+		// and det U_{S,L} = (-1)^{\sum S + \sum L} det U det U_{S',L'}
+		// (complementary minor for orthogonal U)
 		void initTerms(size_t sigma)
 		{
 			assert(engine_->dof()==1);
 			size_t n = engine_->size();
-			std::vector<bool> v(n,false);
-			if (ne_[sigma]==0) {
+			size_t ne = ne_[sigma];
+			bool particleHole = (2*ne>n);
+			size_t k = (particleHole) ? n - ne : ne;
+			size_t offset = (particleHole) ? ne : 0;
+			RealType factor = 1.0;
+			if (particleHole) {
+				factor = determinant();
+				if ((ne*(ne-1)/2) & 1) factor = -factor;
+			}
+
+			std::vector<bool> v(n,particleHole);
+			if (k==0) {
 				FlavoredStateType fl(engine_->dof(),v.size());
 				fl.pushInto(sigma,v);
 				terms_.push_back(fl);
-				values_.push_back(1.0);
+				values_.push_back(factor);
 				return;
 			}
 
-			ArrangementsWithoutRepetitionType ap(n,ne_[sigma]);
+			ArrangementsWithoutRepetitionType ap(n,k);
 			//std::cerr<<"ap.size="<<ap.size()<<"\n";
 			while (ap.increase()) {
 				PermutationsType p(ap);
 				//std::cerr<<"p.size="<<p.size()<<" terms="<<terms_.size()<<"\n";
-				for (size_t i=0;i<v.size();i++) v[i] = false;
-				for (size_t i=0;i<ne_[sigma];i++) v[p[i]] = true;
+				for (size_t i=0;i<v.size();i++) v[i] = particleHole;
+				size_t sumOfSites = 0;
+				for (size_t i=0;i<k;i++) {
+					v[p[i]] = !particleHole;
+					sumOfSites += p[i];
+				}
 				RealType sum = 0;
 				do {
 //					std::cerr<<"--------> "<<p<<" <---------\n";
 					RealType prod = (isArrangementOdd(p)) ? -1.0 : 1.0;
-					for (size_t i=0;i<ne_[sigma];i++) {
-						prod *= engine_->eigenvector(p[i],i);
+					for (size_t i=0;i<k;i++) {
+						prod *= engine_->eigenvector(p[i],offset+i);
 					}
 					sum += prod;
 				} while (p.increase());
+				if (particleHole) {
+					size_t sumOfFilled = n*(n-1)/2 - sumOfSites;
+					sum *= (sumOfFilled & 1) ? -factor : factor;
+				}
 				FlavoredStateType fl(engine_->dof(),v.size());
 				fl.pushInto(sigma,v);
 				terms_.push_back(fl);
@@ -230,6 +305,49 @@ namespace FreeFermions {
 			};
 		}
 
+		// mean time to build a state of ne electrons, over 10ms at least
+		static RealType timeOf(const EngineType& engine,size_t ne)
+		{
+			std::vector<size_t> v(1,ne);
+			size_t repetitions = 0;
+			RealType start = DryRun<RealType>::now();
+			RealType elapsed = 0;
+			do {
+				ThisType state(engine,v);
+				repetitions++;
+				elapsed = DryRun<RealType>::now() - start;
+			} while (elapsed<0.01);
+			return elapsed/repetitions;
+		}
+
+		// LU with partial pivoting, n^3 but it's done only once
+		RealType determinant() const
+		{
+			size_t n = engine_->size();
+			std::vector<RealType> a(n*n);
+			for (size_t i=0;i<n;i++)
+				for (size_t j=0;j<n;j++)
+					a[i+j*n] = engine_->eigenvector(i,j);
+
+			RealType det = 1.0;
+			for (size_t j=0;j<n;j++) {
+				size_t pivot = j;
+				for (size_t i=j+1;i<n;i++)
+					if (fabs(a[i+j*n])>fabs(a[pivot+j*n])) pivot = i;
+				if (a[pivot+j*n]==0) return 0;
+				if (pivot!=j) {
+					for (size_t l=0;l<n;l++) std::swap(a[j+l*n],a[pivot+l*n]);
+					det = -det;
+				}
+				det *= a[j+j*n];
+				for (size_t i=j+1;i<n;i++) {
+					RealType f = a[i+j*n]/a[j+j*n];
+					for (size_t l=j;l<n;l++) a[i+l*n] -= f*a[j+l*n];
+				}
+			}
+			return det;
+		}
+
 		template<typename SomeVectorType>
 		bool isArrangementOdd(const SomeVectorType& v)
 		{
@@ -258,7 +376,7 @@ namespace FreeFermions {
 			std::vector<FieldType> values2 = values_;
 			values_.clear();
 			terms_.push_back(prev);
-			values_.push_back(values_[0]);
+			values_.push_back(values2[0]);
 			for (size_t i=1;i<terms2.size();i++) {
 				if (fabs(values2[i])<1e-8) continue;
 				terms_.push_back(terms2[i]);
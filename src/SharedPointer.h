@@ -0,0 +1,161 @@
+// BEGIN LICENSE BLOCK
+/*
+Copyright (c) 2011 , UT-Battelle, LLC
+All rights reserved
+
+[FreeFermions, Version 1.0.0]
+[by G.A., Oak Ridge National Laboratory]
+
+UT Battelle Open Source Software License 11242008
+
+OPEN SOURCE LICENSE
+
+Subject to the conditions of this License, each
+contributor to this software hereby grants, free of
+charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), a
+perpetual, worldwide, non-exclusive, no-charge,
+royalty-free, irrevocable copyright license to use, copy,
+modify, merge, publish, distribute, and/or sublicense
+copies of the Software.
+
+1. Redistributions of Software must retain the above
+copyright and license notices, this list of conditions,
+and the following disclaimer.  Changes or modifications
+to, or derivative works of, the Software should be noted
+with comments and the contributor and organization's
+name.
+
+2. Neither the names of UT-Battelle, LLC or the
+Department of Energy nor the names of the Software
+contributors may be used to endorse or promote products
+derived from this software without specific prior written
+permission of UT-Battelle.
+
+3. The software and the end-user documentation included
+with the redistribution, with or without modification,
+must include the following acknowledgment:
+
+"This product includes software produced by UT-Battelle,
+LLC under Contract No. DE-AC05-00OR22725  with the
+Department of Energy."
+ 
+*********************************************************
+DISCLAIMER
+
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+COPYRIGHT OWNER, CONTRIBUTORS, UNITED STATES GOVERNMENT,
+OR THE UNITED STATES DEPARTMENT OF ENERGY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+DAMAGE.
+
+NEITHER THE UNITED STATES GOVERNMENT, NOR THE UNITED
+STATES DEPARTMENT OF ENERGY, NOR THE COPYRIGHT OWNER, NOR
+ANY OF THEIR EMPLOYEES, REPRESENTS THAT THE USE OF ANY
+INFORMATION, DATA, APPARATUS, PRODUCT, OR PROCESS
+DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
+
+*********************************************************
+
+
+*/
+// END LICENSE BLOCK
+/** \ingroup DMRG */
+/*@{*/
+
+/*! \file SharedPointer.h
+ *
+ * A reference counted pointer: copies share the object,
+ * which is deleted by the last one
+ *
+ */
+#ifndef SHARED_POINTER_H
+#define SHARED_POINTER_H
+
+#include <cstddef>
+
+namespace FreeFermions {
+
+	//! Copies may be made and dropped in different threads: the count is
+	//! atomic with GCC-compatible compilers, elsewhere copies must stay
+	//! in one thread. The object itself is not guarded
+	template<typename T>
+	class SharedPointer {
+
+		typedef SharedPointer<T> ThisType;
+
+	public:
+
+		explicit SharedPointer(T* p = 0)
+		: p_(p),counter_((p) ? new size_t(1) : 0)
+		{}
+
+		SharedPointer(const ThisType& x)
+		: p_(x.p_),counter_(x.counter_)
+		{
+			if (counter_) increment(counter_);
+		}
+
+		~SharedPointer() { release(); }
+
+		ThisType& operator=(const ThisType& x)
+		{
+			if (x.counter_) increment(x.counter_);
+			release();
+			p_ = x.p_;
+			counter_ = x.counter_;
+			return *this;
+		}
+
+		T* get() const { return p_; }
+
+		T& operator*() const { return *p_; }
+
+		T* operator->() const { return p_; }
+
+	private:
+
+		void release()
+		{
+			if (!counter_) return;
+			if (decrement(counter_)>0) return;
+			delete p_;
+			delete counter_;
+		}
+
+		static void increment(size_t* counter)
+		{
+#ifdef __GNUC__
+			__sync_add_and_fetch(counter,1);
+#else
+			(*counter)++;
+#endif
+		}
+
+		static size_t decrement(size_t* counter)
+		{
+#ifdef __GNUC__
+			return __sync_sub_and_fetch(counter,1);
+#else
+			return --(*counter);
+#endif
+		}
+
+		T* p_;
+		size_t* counter_;
+	}; // SharedPointer
+} // namespace FreeFermions
+
+/*@}*/
+#endif // SHARED_POINTER_H
@@ -0,0 +1,521 @@
+// BEGIN LICENSE BLOCK
+/*
+Copyright (c) 2011 , UT-Battelle, LLC
+All rights reserved
+
+[FreeFermions, Version 1.0.0]
+[by G.A., Oak Ridge National Laboratory]
+
+UT Battelle Open Source Software License 11242008
+
+OPEN SOURCE LICENSE
+
+Subject to the conditions of this License, each
+contributor to this software hereby grants, free of
+charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), a
+perpetual, worldwide, non-exclusive, no-charge,
+royalty-free, irrevocable copyright license to use, copy,
+modify, merge, publish, distribute, and/or sublicense
+copies of the Software.
+
+1. Redistributions of Software must retain the above
+copyright and license notices, this list of conditions,
+and the following disclaimer.  Changes or modifications
+to, or derivative works of, the Software should be noted
+with comments and the contributor and organization's
+name.
+
+2. Neither the names of UT-Battelle, LLC or the
+Department of Energy nor the names of the Software
+contributors may be used to endorse or promote products
+derived from this software without specific prior written
+permission of UT-Battelle.
+
+3. The software and the end-user documentation included
+with the redistribution, with or without modification,
+must include the following acknowledgment:
+
+"This product includes software produced by UT-Battelle,
+LLC under Contract No. DE-AC05-00OR22725  with the
+Department of Energy."
+ 
+*********************************************************
+DISCLAIMER
+
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+COPYRIGHT OWNER, CONTRIBUTORS, UNITED STATES GOVERNMENT,
+OR THE UNITED STATES DEPARTMENT OF ENERGY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+DAMAGE.
+
+NEITHER THE UNITED STATES GOVERNMENT, NOR THE UNITED
+STATES DEPARTMENT OF ENERGY, NOR THE COPYRIGHT OWNER, NOR
+ANY OF THEIR EMPLOYEES, REPRESENTS THAT THE USE OF ANY
+INFORMATION, DATA, APPARATUS, PRODUCT, OR PROCESS
+DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
+
+*********************************************************
+
+
+*/
+// END LICENSE BLOCK
+/** \ingroup DMRG */
+/*@{*/
+
+/*! \file StateFamily.h
+ *
+ * States that share operator prefixes, stored as the nodes
+ * of an operator trie, and evaluated one node at a time
+ *
+ */
+#ifndef STATE_FAMILY_H
+#define STATE_FAMILY_H
+
+#include "HilbertState.h"
+#include <map>
+#include <algorithm>
+
+namespace FreeFermions {
+
+	template<typename CorDOperatorType_,
+	          typename DiagonalOperatorType_=
+	                    DummyOperator<typename CorDOperatorType_::FieldType> >
+	class StateFamily {
+		typedef typename CorDOperatorType_::EngineType EngineType;
+		typedef typename CorDOperatorType_::RealType RealType;
+		typedef typename CorDOperatorType_::FieldType FieldType;
+		typedef StateFamily<CorDOperatorType_,DiagonalOperatorType_> ThisType;
+
+		enum {CREATION = CorDOperatorType_::CREATION,
+		       DESTRUCTION = CorDOperatorType_::DESTRUCTION,
+		       DIAGONAL,
+		       BILINEAR
+		};
+
+		typedef BilinearOperator<CorDOperatorType_> BilinearOperatorType_;
+
+		// levels where a configuration differs from the reference, sorted
+		typedef std::vector<size_t> ConfigurationType;
+		// a state of one flavor in the basis of configurations
+		typedef std::map<ConfigurationType,FieldType> FockVectorType;
+		typedef std::vector<SharedPointer<FockVectorType> > FockVectorsType;
+
+		struct Node {
+			Node(size_t p,
+			     const CorDOperatorType_* o,
+			     const DiagonalOperatorType_* d,
+			     const BilinearOperatorType_* b = 0)
+			: parent(p),op(o),diagonal(d),bilinear(b)
+			{}
+
+			size_t parent;
+			const CorDOperatorType_* op;
+			const DiagonalOperatorType_* diagonal;
+			const BilinearOperatorType_* bilinear;
+			std::map<CanonicalKey,size_t> children;
+			// one per flavor, empty until needed
+			FockVectorsType psi;
+		};
+
+		// a configuration as the C's (particles) and D's (holes)
+		// that make it out of the reference, as diagonal operators expect
+		class Excitations {
+		public:
+			enum {CREATION = ThisType::CREATION,
+			      DESTRUCTION = ThisType::DESTRUCTION};
+
+			Excitations(const ConfigurationType& configuration,
+			            const std::vector<size_t>& occupations,
+			            const RealType& energy)
+			: data_(configuration.size()),energy_(energy)
+			{
+				for (size_t i=0;i<data_.size();i++) {
+					size_t lambda = configuration[i];
+					data_[i].lambda = lambda;
+					data_[i].type = (occupations[lambda]==0) ? CREATION :
+					                                            DESTRUCTION;
+				}
+			}
+
+			size_t size() const { return data_.size(); }
+
+			const FreeOperator& operator[](size_t i) const { return data_[i]; }
+
+			size_t middle() const { return 0; }
+
+			const RealType& vacuumEnergy() const { return energy_; }
+
+		private:
+			std::vector<FreeOperator> data_;
+			RealType energy_;
+		};
+
+	public:
+		typedef CorDOperatorType_ CorDOperatorType;
+		typedef DiagonalOperatorType_ DiagonalOperatorType;
+		typedef BilinearOperatorType_ BilinearOperatorType;
+
+		//! A node of the trie; copies are O(1),
+		//! and applying an operator moves it to a child
+		class State {
+		public:
+			State(ThisType& family,size_t node)
+			: family_(&family),node_(node)
+			{}
+
+			void pushInto(const CorDOperatorType& op)
+			{
+				if (op.type()!=CREATION && op.type()!=DESTRUCTION) return;
+				node_ = family_->child(node_,op);
+			}
+
+			void pushInto(const DiagonalOperatorType& op)
+			{
+				node_ = family_->child(node_,op);
+			}
+
+			void pushInto(const BilinearOperatorType& op)
+			{
+				node_ = family_->child(node_,op);
+			}
+
+			size_t node() const { return node_; }
+
+		private:
+			ThisType* family_;
+			size_t node_;
+		};
+
+		// it's the g.s. for now, as for HilbertState
+		StateFamily(const EngineType& engine,const std::vector<size_t>& ne)
+		: engine_(engine),occupations_(ne.size())
+		{
+			for (size_t i=0;i<occupations_.size();++i) {
+				occupations_[i].resize(engine.size(),0);
+				for (size_t j=0;j<ne[i];++j) occupations_[i][j] = 1;
+			}
+			init();
+		}
+
+		StateFamily(const EngineType& engine,
+		            const std::vector<std::vector<size_t> >& occupations)
+		: engine_(engine),occupations_(occupations)
+		{
+			init();
+		}
+
+		//! The state with no operators applied
+		State root() { return State(*this,0); }
+
+		//! Number of distinct prefixes so far
+		size_t size() const { return nodes_.size(); }
+
+		//! <bra|ket>, each node of the family is evaluated at most once
+		FieldType scalarProduct(const State& bra,const State& ket)
+		{
+			const FockVectorsType& psiBra = psi(bra.node());
+			const FockVectorsType& psiKet = psi(ket.node());
+			FieldType prod = 1.0;
+			for (size_t i=0;i<psiBra.size();i++)
+				prod *= scalarProduct(*psiBra[i],*psiKet[i]);
+			return prod;
+		}
+
+		//! m(i,j) = <states[i]|states[j]>, only i<=j are computed
+		void gramMatrix(PsimagLite::Matrix<FieldType>& m,
+		                const std::vector<State>& states)
+		{
+			size_t n = states.size();
+			m.resize(n,n);
+			for (size_t i=0;i<n;i++) {
+				for (size_t j=i;j<n;j++) {
+					FieldType value = scalarProduct(states[i],states[j]);
+					m(j,i) = std::conj(value);
+					m(i,j) = value;
+				}
+			}
+		}
+
+	private:
+
+		void init()
+		{
+			nodes_.push_back(Node(0,0,0));
+			above_.resize(occupations_.size());
+			energy_.resize(occupations_.size(),0);
+			for (size_t i=0;i<occupations_.size();i++) {
+				if (occupations_[i].size()!=engine_.size())
+					throw std::runtime_error("StateFamily::ctor(...)\n");
+				above_[i].resize(engine_.size());
+				size_t counter = 0;
+				for (int j=engine_.size()-1;j>=0;j--) {
+					above_[i][j] = counter;
+					if (occupations_[i][j]==0) continue;
+					counter++;
+					energy_[i] += engine_.eigenvalue(j);
+				}
+				FockVectorType* psi0 = new FockVectorType;
+				(*psi0)[ConfigurationType()] = 1.0;
+				nodes_[0].psi.push_back(SharedPointer<FockVectorType>(psi0));
+			}
+		}
+
+		template<typename SomeOperatorType>
+		size_t child(size_t node,const SomeOperatorType& op)
+		{
+			CanonicalKey key;
+			appendToKey(key,op);
+			typename std::map<CanonicalKey,size_t>::iterator it =
+			                               nodes_[node].children.find(key);
+			if (it!=nodes_[node].children.end()) return it->second;
+			size_t x = nodes_.size();
+			nodes_.push_back(makeNode(node,op));
+			nodes_[node].children[key] = x;
+			return x;
+		}
+
+		void appendToKey(CanonicalKey& key,const CorDOperatorType& op) const
+		{
+			key.append(op.type());
+			key.append(op.index());
+			key.append(op.sigma());
+		}
+
+		void appendToKey(CanonicalKey& key,const DiagonalOperatorType& op) const
+		{
+			size_t type1 = DIAGONAL;
+			key.append(type1);
+			op.key(key,false);
+		}
+
+		void appendToKey(CanonicalKey& key,const BilinearOperatorType& op) const
+		{
+			size_t type1 = BILINEAR;
+			key.append(type1);
+			op.key(key,false);
+			key.append(op.sigma());
+		}
+
+		Node makeNode(size_t parent,const CorDOperatorType& op) const
+		{
+			return Node(parent,&op,0);
+		}
+
+		Node makeNode(size_t parent,const DiagonalOperatorType& op) const
+		{
+			return Node(parent,0,&op);
+		}
+
+		Node makeNode(size_t parent,const BilinearOperatorType& op) const
+		{
+			return Node(parent,0,0,&op);
+		}
+
+		const FockVectorsType& psi(size_t node)
+		{
+			if (nodes_[node].psi.size()>0) return nodes_[node].psi;
+
+			// flavors the operator doesn't touch are shared with the parent
+			FockVectorsType psi1 = psi(nodes_[node].parent);
+			const Node& thisNode = nodes_[node];
+			if (thisNode.diagonal && !thisNode.diagonal->multiplicative()) {
+				applyTotal(psi1,*thisNode.diagonal);
+				nodes_[node].psi = psi1;
+				return nodes_[node].psi;
+			}
+			for (size_t i=0;i<psi1.size();i++) {
+				if (thisNode.op && thisNode.op->sigma()!=i) continue;
+				if (thisNode.bilinear && thisNode.bilinear->sigma()!=i) continue;
+				FockVectorType* v = new FockVectorType;
+				if (thisNode.op) apply(*v,*thisNode.op,*psi1[i]);
+				else if (thisNode.bilinear) apply(*v,*thisNode.bilinear,*psi1[i]);
+				else apply(*v,*thisNode.diagonal,*psi1[i],i,0.0);
+				psi1[i] = SharedPointer<FockVectorType>(v);
+			}
+			nodes_[node].psi = psi1;
+			return nodes_[node].psi;
+		}
+
+		void apply(FockVectorType& dest,
+		           const CorDOperatorType& op,
+		           const FockVectorType& src) const
+		{
+			size_t sigma = op.sigma();
+			typename FockVectorType::const_iterator it;
+			for (it=src.begin();it!=src.end();++it) {
+				const ConfigurationType& c = it->first;
+				for (size_t lambda=0;lambda<engine_.size();lambda++) {
+					FieldType a = op(lambda);
+					if (a==FieldType(0)) continue;
+					ConfigurationType c2;
+					RealType sign = 0;
+					if (!move(c2,sign,op.type(),sigma,lambda,c)) continue;
+					dest[c2] += sign*a*it->second;
+				}
+			}
+		}
+
+		void apply(FockVectorType& dest,
+		           const BilinearOperatorType& op,
+		           const FockVectorType& src) const
+		{
+			size_t sigma = op.sigma();
+			size_t first = op.first();
+			size_t second = (first==CREATION) ? DESTRUCTION : CREATION;
+			size_t n = engine_.size();
+			typename FockVectorType::const_iterator it;
+			for (it=src.begin();it!=src.end();++it) {
+				const ConfigurationType& c = it->first;
+				for (size_t lambda=0;lambda<n;lambda++) {
+					ConfigurationType c2;
+					RealType sign = 0;
+					if (!move(c2,sign,first,sigma,lambda,c)) continue;
+					for (size_t lambda2=0;lambda2<n;lambda2++) {
+						// op(creation level, destruction level)
+						FieldType a = (first==CREATION) ? op(lambda,lambda2) :
+						                                  op(lambda2,lambda);
+						if (a==FieldType(0)) continue;
+						ConfigurationType c3;
+						RealType sign2 = 0;
+						if (!move(c3,sign2,second,sigma,lambda2,c2)) continue;
+						dest[c3] += sign*sign2*a*it->second;
+					}
+				}
+			}
+		}
+
+		//! c2 and sign of a C or D on level lambda of c, false if it's zero
+		bool move(ConfigurationType& c2,
+		          RealType& sign,
+		          size_t type,
+		          size_t sigma,
+		          size_t lambda,
+		          const ConfigurationType& c) const
+		{
+			ConfigurationType::const_iterator found =
+			                 std::lower_bound(c.begin(),c.end(),lambda);
+			bool excited = (found!=c.end() && *found==lambda);
+			bool occupied = ((occupations_[sigma][lambda]!=0) != excited);
+			if (type==CREATION && occupied) return false;
+			if (type==DESTRUCTION && !occupied) return false;
+
+			c2 = c;
+			if (excited) c2.erase(c2.begin()+(found-c.begin()));
+			else c2.insert(c2.begin()+(found-c.begin()),lambda);
+
+			sign = (electronsAbove(sigma,lambda,c) & 1) ? -1 : 1;
+			return true;
+		}
+
+		//! others is the energy of the other flavors, for operators
+		//! that don't multiply on flavors, see applyTotal()
+		void apply(FockVectorType& dest,
+		           const DiagonalOperatorType& op,
+		           const FockVectorType& src,
+		           size_t sigma,
+		           const RealType& others) const
+		{
+			if (op.size()!=1)
+				throw std::runtime_error("StateFamily: diagonal operators "
+				                         "with grids aren't supported\n");
+			typename FockVectorType::const_iterator it;
+			for (it=src.begin();it!=src.end();++it) {
+				Excitations excitations(it->first,
+				                        occupations_[sigma],
+				                        energy_[sigma]+others);
+				dest[it->first] = it->second*op(excitations,excitations.size());
+			}
+		}
+
+		// an operator that doesn't multiply on flavors, as 1/(z-H), needs
+		// the total energy, which the product of flavors has only if all
+		// of them but one, the one it's applied to, have a definite energy
+		void applyTotal(FockVectorsType& psi,
+		                const DiagonalOperatorType& op) const
+		{
+			size_t target = 0;
+			size_t indefinite = 0;
+			std::vector<RealType> energies(psi.size(),0.0);
+			for (size_t i=0;i<psi.size();i++) {
+				if (definite(energies[i],*psi[i],i)) continue;
+				target = i;
+				indefinite++;
+			}
+			if (indefinite>1)
+				throw std::runtime_error("StateFamily: flavors of this "
+				                         "diagonal operator don't multiply\n");
+			RealType others = 0;
+			for (size_t i=0;i<psi.size();i++)
+				if (i!=target) others += energies[i];
+			FockVectorType* v = new FockVectorType;
+			apply(*v,op,*psi[target],target,others);
+			psi[target] = SharedPointer<FockVectorType>(v);
+		}
+
+		//! True if all configurations of v have the same energy, then
+		//! set; zero vectors have any energy, and are given zero
+		bool definite(RealType& energy,
+		              const FockVectorType& v,
+		              size_t sigma) const
+		{
+			energy = 0;
+			typename FockVectorType::const_iterator it;
+			for (it=v.begin();it!=v.end();++it) {
+				Excitations excitations(it->first,
+				                        occupations_[sigma],
+				                        energy_[sigma]);
+				RealType e = energyAt(excitations,excitations.size(),engine_);
+				if (it!=v.begin() && fabs(e-energy)>1e-10) return false;
+				energy = e;
+			}
+			return true;
+		}
+
+		size_t electronsAbove(size_t sigma,
+		                      size_t lambda,
+		                      const ConfigurationType& c) const
+		{
+			int counter = above_[sigma][lambda];
+			for (size_t i=0;i<c.size();i++) {
+				if (c[i]<=lambda) continue;
+				// a particle above the reference or a hole in it
+				counter += (occupations_[sigma][c[i]]==0) ? 1 : -1;
+			}
+			return counter;
+		}
+
+		FieldType scalarProduct(const FockVectorType& bra,
+		                        const FockVectorType& ket) const
+		{
+			FieldType sum = 0;
+			typename FockVectorType::const_iterator it;
+			for (it=ket.begin();it!=ket.end();++it) {
+				typename FockVectorType::const_iterator it2 = bra.find(it->first);
+				if (it2==bra.end()) continue;
+				sum += std::conj(it2->second)*it->second;
+			}
+			return sum;
+		}
+
+		const EngineType& engine_;
+		std::vector<std::vector<size_t> > occupations_;
+		std::vector<std::vector<size_t> > above_;
+		std::vector<RealType> energy_;
+		std::vector<Node> nodes_;
+	}; // StateFamily
+} // namespace FreeFermions
+
+/*@}*/
+#endif // STATE_FAMILY_H